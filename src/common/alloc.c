@@ -3,6 +3,11 @@
 #include <string.h>
 
 #include "errors.h"
+#include "alloc.h"
+
+// the allocator itself calls the C library
+#undef _REALLOC
+#undef _FREE
 
 #ifdef USE_GC
 #include "gc.h"
@@ -69,3 +74,114 @@ void _mem_free(void* ptr) {
     if(ptr != NULL)
         _FREE(ptr);
 }
+
+struct _arena_block_t_ {
+    _arena_block_t* next;
+    size_t size; // bytes in data
+    size_t used;
+    max_align_t data[];
+};
+
+static _arena_block_t* new_block(size_t size) {
+
+    _arena_block_t* block = _MALLOC(sizeof(_arena_block_t) + size);
+    if(block == NULL)
+        FATAL("cannot allocate %lu bytes for an arena", size);
+
+    block->next = NULL;
+    block->size = size;
+    block->used = 0;
+    return block;
+}
+
+arena_t* create_arena(size_t block_size) {
+
+    arena_t* arena = _mem_alloc(sizeof(arena_t));
+    arena->block_size = (block_size < 256) ? 256 : block_size;
+
+    return arena;
+}
+
+static void free_blocks(_arena_block_t* block) {
+
+    while(block != NULL) {
+        _arena_block_t* next = block->next;
+        _FREE(block);
+        block = next;
+    }
+}
+
+void destroy_arena(arena_t* arena) {
+
+    if(arena != NULL) {
+        free_blocks(arena->head);
+        free_blocks(arena->spare);
+        _FREE(arena);
+    }
+}
+
+/*
+ * Free everything in the arena. The blocks are kept for the allocations
+ * that follow, and the blocks in use are linked to them as a whole.
+ */
+void reset_arena(arena_t* arena) {
+
+    if(arena->head != NULL) {
+        arena->last->next = arena->spare;
+        arena->spare = arena->head;
+        arena->head = arena->last = NULL;
+    }
+}
+
+// the memory is zeroed, like _mem_alloc()
+void* _arena_alloc(arena_t* arena, size_t size) {
+
+    size = (size + sizeof(max_align_t) - 1) & ~(sizeof(max_align_t) - 1);
+
+    _arena_block_t* block = arena->head;
+    if(block == NULL || block->used + size > block->size) {
+        if(size > arena->block_size / 4) {
+            // a large allocation gets a block of its own behind the head
+            block = new_block(size);
+            if(arena->head == NULL)
+                arena->head = arena->last = block;
+            else {
+                block->next = arena->head->next;
+                arena->head->next = block;
+                if(arena->last == arena->head)
+                    arena->last = block;
+            }
+        }
+        else {
+            if(arena->spare != NULL && arena->spare->size >= size) {
+                block = arena->spare;
+                arena->spare = block->next;
+                block->used = 0;
+            }
+            else
+                block = new_block(arena->block_size);
+
+            block->next = arena->head;
+            if(arena->head == NULL)
+                arena->last = block;
+            arena->head = block;
+        }
+    }
+
+    void* ptr = (char*)block->data + block->used;
+    block->used += size;
+    memset(ptr, 0, size);
+
+    return ptr;
+}
+
+char* _arena_copy_string(arena_t* arena, const char* str) {
+
+    size_t len = (str != NULL) ? strlen(str) + 1 : 1;
+    char* ptr = _arena_alloc(arena, len);
+
+    if(str != NULL)
+        memcpy(ptr, str, len);
+
+    return ptr;
+}
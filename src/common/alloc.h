@@ -15,6 +15,30 @@
 #define _COPY_STRING(s) _mem_copy_string(s)
 #define _FREE(p) _mem_free((void*)(p))
 
+/*
+ * A region of memory that things are bump allocated from and that is
+ * freed all at once. Nothing in a region is freed by itself.
+ */
+typedef struct _arena_block_t_ _arena_block_t;
+
+typedef struct {
+    _arena_block_t* head;  // block that is allocated from
+    _arena_block_t* last;  // oldest block in use
+    _arena_block_t* spare; // blocks kept by reset_arena()
+    size_t block_size;
+} arena_t;
+
+#define _ARENA_ALLOC(a, s) _arena_alloc((a), (s))
+#define _ARENA_TYPE(a, t) (t*)_arena_alloc((a), sizeof(t))
+#define _ARENA_ARRAY(a, t, n) (t*)_arena_alloc((a), sizeof(t) * (n))
+#define _ARENA_STRING(a, s) _arena_copy_string((a), (s))
+
+arena_t* create_arena(size_t block_size);
+void destroy_arena(arena_t* arena);
+void reset_arena(arena_t* arena);
+void* _arena_alloc(arena_t* arena, size_t size);
+char* _arena_copy_string(arena_t* arena, const char* str);
+
 void* _mem_alloc(size_t);
 void* _mem_realloc(void*, size_t);
 void* _mem_copy(void*, size_t);
@@ -0,0 +1,384 @@
+/*
+ * Operations on whole bit sets.
+ *
+ * Each operation has a portable version and, on x86, SSE2 and AVX2
+ * versions. The first call picks the widest set of them that the CPU
+ * runs, so the program does not have to be built for one CPU. The vector
+ * versions do the words that fill whole registers and leave the rest to
+ * the portable version.
+ *
+ * Test build string:
+ * clang -Wall -Wextra -g -DTEST_BITS -o t bitset.c
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "bitset.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define BITS_X86
+#include <immintrin.h>
+#endif
+
+typedef struct {
+    const char* name;
+    int (*or_op)(uint64_t* dest, const uint64_t* src, int words);
+    int (*and_op)(uint64_t* dest, const uint64_t* src, int words);
+    int (*andnot_op)(uint64_t* dest, const uint64_t* src, int words);
+    int (*count)(const uint64_t* set, int words);
+    int (*equal)(const uint64_t* s1, const uint64_t* s2, int words);
+    int (*empty)(const uint64_t* set, int words);
+} kernels_t;
+
+/*
+ * Portable versions.
+ */
+#define SCALAR_OP(name, expr)                                       \
+    static int name(uint64_t* dest, const uint64_t* src, int words) { \
+        uint64_t changed = 0;                                       \
+        for(int i = 0; i < words; i++) {                            \
+            uint64_t d = dest[i];                                   \
+            uint64_t s = src[i];                                    \
+            uint64_t w = (expr);                                    \
+            changed |= w ^ d;                                       \
+            dest[i] = w;                                            \
+        }                                                           \
+        return changed != 0;                                        \
+    }
+
+SCALAR_OP(or_scalar, d | s)
+SCALAR_OP(and_scalar, d & s)
+SCALAR_OP(andnot_scalar, d & ~s)
+
+static int count_scalar(const uint64_t* set, int words) {
+
+    int count = 0;
+
+    for(int i = 0; i < words; i++)
+        count += __builtin_popcountll(set[i]);
+
+    return count;
+}
+
+static int equal_scalar(const uint64_t* s1, const uint64_t* s2, int words) {
+
+    return memcmp(s1, s2, words * sizeof(uint64_t)) == 0;
+}
+
+static int empty_scalar(const uint64_t* set, int words) {
+
+    uint64_t any = 0;
+
+    for(int i = 0; i < words; i++)
+        any |= set[i];
+
+    return any == 0;
+}
+
+static const kernels_t scalar_kernels = {
+    "scalar", or_scalar, and_scalar, andnot_scalar, count_scalar, equal_scalar, empty_scalar,
+};
+
+#ifdef BITS_X86
+
+/*
+ * SSE2 versions, two words at a time.
+ */
+#define SSE2_OP(name, scalar, expr)                                                   \
+    __attribute__((target("sse2"))) static int name(uint64_t* dest, const uint64_t* src, int words) { \
+        __m128i changed = _mm_setzero_si128();                                        \
+        int i = 0;                                                                    \
+        for(; i + 2 <= words; i += 2) {                                               \
+            __m128i d = _mm_loadu_si128((const __m128i*)&dest[i]);                    \
+            __m128i s = _mm_loadu_si128((const __m128i*)&src[i]);                     \
+            __m128i w = (expr);                                                       \
+            changed = _mm_or_si128(changed, _mm_xor_si128(w, d));                     \
+            _mm_storeu_si128((__m128i*)&dest[i], w);                                  \
+        }                                                                             \
+        uint64_t lanes[2];                                                            \
+        _mm_storeu_si128((__m128i*)lanes, changed);                                   \
+        return scalar(&dest[i], &src[i], words - i) | ((lanes[0] | lanes[1]) != 0);   \
+    }
+
+SSE2_OP(or_sse2, or_scalar, _mm_or_si128(d, s))
+SSE2_OP(and_sse2, and_scalar, _mm_and_si128(d, s))
+SSE2_OP(andnot_sse2, andnot_scalar, _mm_andnot_si128(s, d))
+
+__attribute__((target("sse2"))) static int equal_sse2(const uint64_t* s1, const uint64_t* s2, int words) {
+
+    int i = 0;
+
+    for(; i + 2 <= words; i += 2) {
+        __m128i a = _mm_loadu_si128((const __m128i*)&s1[i]);
+        __m128i b = _mm_loadu_si128((const __m128i*)&s2[i]);
+        if(_mm_movemask_epi8(_mm_cmpeq_epi32(a, b)) != 0xffff)
+            return 0;
+    }
+
+    return equal_scalar(&s1[i], &s2[i], words - i);
+}
+
+__attribute__((target("sse2"))) static int empty_sse2(const uint64_t* set, int words) {
+
+    __m128i any = _mm_setzero_si128();
+    int i = 0;
+
+    for(; i + 2 <= words; i += 2)
+        any = _mm_or_si128(any, _mm_loadu_si128((const __m128i*)&set[i]));
+
+    return _mm_movemask_epi8(_mm_cmpeq_epi32(any, _mm_setzero_si128())) == 0xffff
+           && empty_scalar(&set[i], words - i);
+}
+
+__attribute__((target("popcnt"))) static int count_popcnt(const uint64_t* set, int words) {
+
+    int count = 0;
+
+    for(int i = 0; i < words; i++)
+        count += __builtin_popcountll(set[i]);
+
+    return count;
+}
+
+static const kernels_t sse2_kernels = {
+    "sse2", or_sse2, and_sse2, andnot_sse2, count_scalar, equal_sse2, empty_sse2,
+};
+
+static const kernels_t sse2_popcnt_kernels = {
+    "sse2+popcnt", or_sse2, and_sse2, andnot_sse2, count_popcnt, equal_sse2, empty_sse2,
+};
+
+/*
+ * AVX2 versions, four words at a time.
+ */
+#define AVX2_OP(name, scalar, expr)                                                   \
+    __attribute__((target("avx2"))) static int name(uint64_t* dest, const uint64_t* src, int words) { \
+        __m256i changed = _mm256_setzero_si256();                                     \
+        int i = 0;                                                                    \
+        for(; i + 4 <= words; i += 4) {                                               \
+            __m256i d = _mm256_loadu_si256((const __m256i*)&dest[i]);                 \
+            __m256i s = _mm256_loadu_si256((const __m256i*)&src[i]);                  \
+            __m256i w = (expr);                                                       \
+            changed = _mm256_or_si256(changed, _mm256_xor_si256(w, d));               \
+            _mm256_storeu_si256((__m256i*)&dest[i], w);                               \
+        }                                                                             \
+        return scalar(&dest[i], &src[i], words - i) | !_mm256_testz_si256(changed, changed); \
+    }
+
+AVX2_OP(or_avx2, or_scalar, _mm256_or_si256(d, s))
+AVX2_OP(and_avx2, and_scalar, _mm256_and_si256(d, s))
+AVX2_OP(andnot_avx2, andnot_scalar, _mm256_andnot_si256(s, d))
+
+__attribute__((target("avx2"))) static int equal_avx2(const uint64_t* s1, const uint64_t* s2, int words) {
+
+    int i = 0;
+
+    for(; i + 4 <= words; i += 4) {
+        __m256i a = _mm256_loadu_si256((const __m256i*)&s1[i]);
+        __m256i b = _mm256_loadu_si256((const __m256i*)&s2[i]);
+        __m256i diff = _mm256_xor_si256(a, b);
+        if(!_mm256_testz_si256(diff, diff))
+            return 0;
+    }
+
+    return equal_scalar(&s1[i], &s2[i], words - i);
+}
+
+__attribute__((target("avx2"))) static int empty_avx2(const uint64_t* set, int words) {
+
+    __m256i any = _mm256_setzero_si256();
+    int i = 0;
+
+    for(; i + 4 <= words; i += 4)
+        any = _mm256_or_si256(any, _mm256_loadu_si256((const __m256i*)&set[i]));
+
+    return _mm256_testz_si256(any, any) && empty_scalar(&set[i], words - i);
+}
+
+/*
+ * Count the bits of each nibble with a table lookup, then add up the
+ * bytes of each word with the sum of absolute differences from zero.
+ */
+__attribute__((target("avx2,popcnt"))) static int count_avx2(const uint64_t* set, int words) {
+
+    const __m256i table = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                           0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i low = _mm256_set1_epi8(0x0f);
+    __m256i sum = _mm256_setzero_si256();
+    int i = 0;
+
+    for(; i + 4 <= words; i += 4) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)&set[i]);
+        __m256i lo = _mm256_shuffle_epi8(table, _mm256_and_si256(v, low));
+        __m256i hi = _mm256_shuffle_epi8(table, _mm256_and_si256(_mm256_srli_epi16(v, 4), low));
+        sum = _mm256_add_epi64(sum, _mm256_sad_epu8(_mm256_add_epi8(lo, hi), _mm256_setzero_si256()));
+    }
+
+    uint64_t lanes[4];
+    _mm256_storeu_si256((__m256i*)lanes, sum);
+
+    return (int)(lanes[0] + lanes[1] + lanes[2] + lanes[3]) + count_popcnt(&set[i], words - i);
+}
+
+static const kernels_t avx2_kernels = {
+    "avx2", or_avx2, and_avx2, andnot_avx2, count_avx2, equal_avx2, empty_avx2,
+};
+
+#endif /* BITS_X86 */
+
+static const kernels_t* select_kernels(void) {
+
+#ifdef BITS_X86
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt"))
+        return &avx2_kernels;
+    if(__builtin_cpu_supports("sse2"))
+        return __builtin_cpu_supports("popcnt") ? &sse2_popcnt_kernels : &sse2_kernels;
+#endif
+
+    return &scalar_kernels;
+}
+
+static const kernels_t* active = NULL;
+
+// any thread may be the first to get here, they all pick the same
+static inline const kernels_t* kernels(void) {
+
+    const kernels_t* k = __atomic_load_n(&active, __ATOMIC_ACQUIRE);
+
+    if(k == NULL) {
+        k = select_kernels();
+        __atomic_store_n(&active, k, __ATOMIC_RELEASE);
+    }
+
+    return k;
+}
+
+int bits_or(uint64_t* dest, const uint64_t* src, int words) {
+
+    return kernels()->or_op(dest, src, words);
+}
+
+int bits_and(uint64_t* dest, const uint64_t* src, int words) {
+
+    return kernels()->and_op(dest, src, words);
+}
+
+int bits_andnot(uint64_t* dest, const uint64_t* src, int words) {
+
+    return kernels()->andnot_op(dest, src, words);
+}
+
+int bits_count(const uint64_t* set, int words) {
+
+    return kernels()->count(set, words);
+}
+
+int bits_equal(const uint64_t* s1, const uint64_t* s2, int words) {
+
+    return kernels()->equal(s1, s2, words);
+}
+
+int bits_empty(const uint64_t* set, int words) {
+
+    return kernels()->empty(set, words);
+}
+
+// each word is mixed into the one before it, so this stays scalar
+uint64_t bits_hash(const uint64_t* set, int words) {
+
+    uint64_t hash = 0x9e3779b97f4a7c15ull;
+
+    for(int i = 0; i < words; i++) {
+        hash ^= set[i];
+        hash *= 0xff51afd7ed558ccdull;
+        hash ^= hash >> 32;
+    }
+
+    return hash;
+}
+
+// the name of the versions that are in use
+const char* bits_kernels(void) {
+
+    return kernels()->name;
+}
+
+/*
+ * Testing the bit sets. Every version that the CPU runs is checked against
+ * the portable one.
+ */
+#ifdef TEST_BITS
+#include <stdio.h>
+#include <stdlib.h>
+
+static uint64_t random_word(void) {
+
+    uint64_t w = 0;
+    for(int i = 0; i < 4; i++)
+        w = (w << 16) ^ (rand() & 0xffff);
+
+    // sparse and empty words too
+    switch(rand() % 4) {
+        case 0: return 0;
+        case 1: return w & (w >> 7) & (w >> 13);
+        default: return w;
+    }
+}
+
+static int check(const kernels_t* k) {
+
+    uint64_t a[37], b[37], c[37], d[37];
+    int errors = 0;
+
+    for(int round = 0; round < 10000; round++) {
+        int words = rand() % 37;
+        for(int i = 0; i < words; i++) {
+            a[i] = random_word();
+            b[i] = (rand() % 3 == 0) ? a[i] : random_word();
+        }
+
+        int (*ops[3][2])(uint64_t*, const uint64_t*, int) = {
+            { scalar_kernels.or_op, k->or_op },
+            { scalar_kernels.and_op, k->and_op },
+            { scalar_kernels.andnot_op, k->andnot_op },
+        };
+        for(int op = 0; op < 3; op++) {
+            memcpy(c, a, sizeof(a));
+            memcpy(d, a, sizeof(a));
+            if(ops[op][0](c, b, words) != ops[op][1](d, b, words) || memcmp(c, d, words * sizeof(uint64_t)) != 0)
+                errors++;
+        }
+
+        if(scalar_kernels.count(a, words) != k->count(a, words))
+            errors++;
+        if(scalar_kernels.equal(a, b, words) != k->equal(a, b, words))
+            errors++;
+        if(scalar_kernels.empty(a, words) != k->empty(a, words))
+            errors++;
+    }
+
+    printf("%s: %d errors\n", k->name, errors);
+    return errors;
+}
+
+int main(void) {
+
+    int errors = check(&scalar_kernels);
+
+#ifdef BITS_X86
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("sse2"))
+        errors += check(&sse2_kernels);
+    if(__builtin_cpu_supports("sse2") && __builtin_cpu_supports("popcnt"))
+        errors += check(&sse2_popcnt_kernels);
+    if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt"))
+        errors += check(&avx2_kernels);
+#endif
+
+    printf("in use: %s\n", bits_kernels());
+    return errors != 0;
+}
+
+#endif /* TEST_BITS */
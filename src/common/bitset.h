@@ -0,0 +1,69 @@
+/*
+ * Dense bit sets stored as arrays of 64 bit words. The caller owns the
+ * storage and passes the number of words, so sets can live inside larger
+ * pools without any per-set allocation.
+ *
+ * The operations on single bits are inline. The operations on whole sets
+ * are in bitset.c, which picks SSE2 or AVX2 versions of them when the CPU
+ * has those.
+ */
+#ifndef _BITSET_H_
+#define _BITSET_H_
+
+#include <stdint.h>
+#include <string.h>
+
+#define BITS_WORDS(n) (((n) + 63) >> 6)
+
+static inline void bits_clear(uint64_t* set, int words) {
+
+    memset(set, 0, words * sizeof(uint64_t));
+}
+
+static inline void bits_set(uint64_t* set, int bit) {
+
+    set[bit >> 6] |= (uint64_t)1 << (bit & 63);
+}
+
+static inline void bits_reset(uint64_t* set, int bit) {
+
+    set[bit >> 6] &= ~((uint64_t)1 << (bit & 63));
+}
+
+static inline int bits_test(const uint64_t* set, int bit) {
+
+    return (set[bit >> 6] >> (bit & 63)) & 1;
+}
+
+/*
+ * Return the first set bit at or after start, or -1.
+ */
+static inline int bits_next(const uint64_t* set, int words, int start) {
+
+    int w = start >> 6;
+
+    if(w >= words)
+        return -1;
+
+    uint64_t word = set[w] & (~(uint64_t)0 << (start & 63));
+    while(word == 0) {
+        if(++w >= words)
+            return -1;
+        word = set[w];
+    }
+
+    return (w << 6) + __builtin_ctzll(word);
+}
+
+// these return non-zero if dest was changed
+int bits_or(uint64_t* dest, const uint64_t* src, int words);
+int bits_and(uint64_t* dest, const uint64_t* src, int words);
+int bits_andnot(uint64_t* dest, const uint64_t* src, int words);
+
+int bits_count(const uint64_t* set, int words);
+int bits_equal(const uint64_t* s1, const uint64_t* s2, int words);
+int bits_empty(const uint64_t* set, int words);
+uint64_t bits_hash(const uint64_t* set, int words);
+const char* bits_kernels(void);
+
+#endif /* _BITSET_H_ */
@@ -1,26 +1,20 @@
 /*
+ * Open addressing with Robin Hood probing.
  *
- *  https://programming.guide/hash-tables-open-addressing.html
+ * The buckets hold the entries themselves, with the full hash and the
+ * length of each key, so a probe only compares the key text when both of
+ * those match. A key is placed in the first free bucket after its home
+ * bucket, but it takes the bucket of any key that it has probed further
+ * than. That keeps every key close to its home, and a search can stop as
+ * soon as it reaches a key that is closer to its home than the search is.
  *
- * The hash table uses linear probing where the probing distance is
- * hash & 0x0F. If the result is 0 then the distance is 1. When a hash
- * is deleted, the memory is freed and the tombstone flag is set. When
- * a hash is added, it can be added to a bucket which is a tombstone.
+ * A key is removed by moving the keys after it back by one bucket, until
+ * a free bucket or a key in its home bucket, so there are no tombstones.
  *
- * The table is full when 3/4 of the buckets are in use. The table is
- * resized and all of the existing hashes are rehashed into the new table.
- *
- * The add function tracks the max number of hops that are needed to
- * insert a new hash. If the hops exceed a certain number, then the hash
- * table should be rehashed, but only if a certain number of adds have
- * taken place to avoid performance problems.
- *
- * Maybe tombstones should be counted instead of hops, but I do not
- * anticipate needing to delete a lot of entries. Rehashing deletes
- * tombstones.
+ * The table doubles when it is 3/4 full.
  *
  * Test build string:
- * clang -Wall -Wextra -g -o t hash.c memory.c errors.c
+ * clang -Wall -Wextra -g -DTEST_HASH -o t hash.c alloc.c
  */
 
 #include <assert.h>
@@ -35,70 +29,91 @@
 
 // #define TEST_HASH
 
-static uint32_t hash_func(const char* key) {
+// hash the key 8 bytes at a time
+uint32_t hash_bytes(const void* ptr, size_t len) {
 
-    uint32_t hash = 2166136261u;
-    int slen = strlen(key);
+    const unsigned char* key = ptr;
+    uint64_t hash = 0x9e3779b97f4a7c15ull ^ len;
+    uint64_t word;
+    size_t i;
 
-    for(int i = 0; i < slen; i++) {
-        hash ^= (uint8_t)key[i];
-        hash *= 16777619;
+    for(i = 0; i + 8 <= len; i += 8) {
+        memcpy(&word, &key[i], 8);
+        hash = (hash ^ word) * 0xff51afd7ed558ccdull;
+        hash ^= hash >> 32;
     }
 
-    return hash;
+    if(i < len) {
+        word = 0;
+        memcpy(&word, &key[i], len - i);
+        hash = (hash ^ word) * 0xff51afd7ed558ccdull;
+    }
+
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ull;
+    hash ^= hash >> 33;
+
+    return (uint32_t)hash;
 }
 
+// how far the entry in the slot is from its home slot
+static inline int distance(hash_table_t* tab, int slot) {
+
+    return (slot - (int)(tab->table[slot].hash & (tab->cap - 1))) & (tab->cap - 1);
+}
+
+// returns the slot of the key, or -1
 static int find_slot(hash_table_t* tab, const char* key) {
 
-    uint32_t hash = hash_func(key) & (tab->cap - 1);
-    int inc = hash & 0x0F;
-    inc = (inc == 0) ? 1 : inc;
+    size_t len = strlen(key);
+    uint32_t hash = hash_bytes(key, len);
+    int mask = tab->cap - 1;
+    int slot = hash & mask;
 
-    if(tab->table[hash] == NULL) {
-        return hash;
+    for(int dist = 0; tab->table[slot].key != NULL && dist <= distance(tab, slot); dist++) {
+        _hash_node_t* node = &tab->table[slot];
+        if(node->hash == hash && node->len == len && memcmp(node->key, key, len) == 0)
+            return slot;
+        slot = (slot + 1) & mask;
     }
-    else {
-        do {
-            for(int i = 0; i < tab->cap; i++) {
-                if(tab->table[hash] == NULL) {
-                    return hash;
-                }
-                else if(tab->table[hash]->key == NULL) {
-                    tab->tombstones--;
-                    return hash;
-                }
-                else if(strcmp(tab->table[hash]->key, key) == 0) {
-                    return hash; // duplicate key
-                }
-                else
-                    hash = (hash + inc) & (tab->cap - 1);
-            }
-            inc = 1; // slot not found
-        } while(true);
+
+    return -1;
+}
+
+// place an entry that is known not to be in the table
+static void place_node(hash_table_t* tab, _hash_node_t node) {
+
+    int mask = tab->cap - 1;
+    int slot = node.hash & mask;
+    int dist = 0;
+
+    while(tab->table[slot].key != NULL) {
+        int d = distance(tab, slot);
+        if(d < dist) {
+            _hash_node_t tmp = tab->table[slot];
+            tab->table[slot] = node;
+            node = tmp;
+            dist = d;
+        }
+        slot = (slot + 1) & mask;
+        dist++;
     }
 
-    return -1; // keep the compiler happy
+    tab->table[slot] = node;
 }
 
 static void rehash_table(hash_table_t* tab) {
 
-    if(tab->count * 1.75 >= tab->cap) {
+    if((tab->count + 1) * 4 > tab->cap * 3) {
         int oldcap = tab->cap;
-        _hash_node_t** oldtab = tab->table;
+        _hash_node_t* oldtab = tab->table;
         tab->cap <<= 1; // double the capacity
-        tab->tombstones = 0;
-        tab->count = 0;
-        tab->table = _ALLOC_ARRAY(_hash_node_t*, tab->cap);
-
-        int slot;
-
-        for(int i = 0; i < oldcap; i++) {
-            if(oldtab[i] != NULL && oldtab[i]->key != NULL) {
-                slot = find_slot(tab, oldtab[i]->key);
-                tab->table[slot] = oldtab[i];
-                tab->count++;
-            }
-        }
+        tab->table = _ALLOC_ARRAY(_hash_node_t, tab->cap);
+
+        for(int i = 0; i < oldcap; i++)
+            if(oldtab[i].key != NULL)
+                place_node(tab, oldtab[i]);
+
         _FREE(oldtab);
     }
 }
@@ -110,7 +125,7 @@ hash_table_t* create_hashtable(void) {
     tab->count = 0;
     tab->cap = 0x01 << 2;
 
-    tab->table = _ALLOC_ARRAY(_hash_node_t*, tab->cap);
+    tab->table = _ALLOC_ARRAY(_hash_node_t, tab->cap);
 
     return tab;
 }
@@ -118,62 +133,45 @@ hash_table_t* create_hashtable(void) {
 void destroy_hashtable(hash_table_t* table) {
 
     if(table != NULL) {
-        for(int i = 0; i < table->cap; i++) {
-            if(table->table[i] != NULL) {
-                if(table->table[i]->key != NULL) {
-                    _FREE(table->table[i]->key);
-                }
-            }
-            _FREE(table->table[i]);
-        }
+        for(int i = 0; i < table->cap; i++)
+            if(table->table[i].key != NULL)
+                _FREE(table->table[i].key);
 
         _FREE(table->table);
         _FREE(table);
     }
 }
 
+// returns 0 if the key is already in the table
 int insert_hashtable(hash_table_t* table, const char* key, void* data) {
 
-    rehash_table(table);
+    if(find_slot(table, key) >= 0)
+        return 0;
 
-    int slot = find_slot(table, key);
-    if(slot < 0) {
-        // printf("cannot find slot for key: \"%s\"\n", key);
-        return -1;
-    }
+    rehash_table(table);
 
-    // help me, obi wan optimizer, you are my only hope
-    if(table->table[slot] != NULL) {
-        if(table->table[slot]->key != NULL) {
-            // printf("cannot store duplicate key: \"%s\"\n", key);
-            return 0;
-        }
-    }
-    else {
-        table->table[slot] = _ALLOC_TYPE(_hash_node_t);
-    }
+    _hash_node_t node;
+    node.len = strlen(key);
+    node.hash = hash_bytes(key, node.len);
+    node.key = _COPY_STRING(key);
+    node.data = data;
 
-    table->table[slot]->key = _COPY_STRING(key);
-    table->table[slot]->data = data;
+    place_node(table, node);
     table->count++;
 
-    // printf("inserted key: %s:%p in %p\n", key, (void*)data, (void*)table);
     return 1;
 }
 
 int find_hashtable(hash_table_t* tab, const char* key, void** data) {
 
-    *data = NULL;
     int slot = find_slot(tab, key);
 
-    if(tab->table[slot] != NULL && tab->table[slot]->key != NULL) {
-        if(strcmp(tab->table[slot]->key, key) == 0) {
-            *data = tab->table[slot]->data;
-            // printf("key = %s\n", key);
-            return 1;
-        }
+    if(slot >= 0) {
+        *data = tab->table[slot].data;
+        return 1;
     }
 
+    *data = NULL;
     return 0;
 }
 
@@ -181,13 +179,20 @@ void remove_hashtable(hash_table_t* tab, const char* key) {
 
     int slot = find_slot(tab, key);
 
-    if((tab->table[slot] != NULL) && (tab->table[slot]->key != NULL)) {
-        if(strcmp(tab->table[slot]->key, key) == 0) {
-            _FREE(tab->table[slot]->key);
-            tab->table[slot]->key = NULL;
-            tab->count--;
-            tab->tombstones++;
+    if(slot >= 0) {
+        int mask = tab->cap - 1;
+        _FREE(tab->table[slot].key);
+
+        // move the entries after it back toward their home slots
+        int next = (slot + 1) & mask;
+        while(tab->table[next].key != NULL && distance(tab, next) > 0) {
+            tab->table[slot] = tab->table[next];
+            slot = next;
+            next = (next + 1) & mask;
         }
+
+        memset(&tab->table[slot], 0, sizeof(_hash_node_t));
+        tab->count--;
     }
 }
 
@@ -198,26 +203,16 @@ void dump_hashtable(hash_table_t* tab) {
     printf("cap = %d\n", tab->cap);
     printf("count = %d\n", tab->count);
     for(int i = 0; i < tab->cap; i++) {
-        if(tab->table[i] != NULL) {
-            if(tab->table[i]->key != NULL) {
-                printf("%3d. slot=%d key=%s\n", count, i, tab->table[i]->key);
-                count++;
-            }
+        if(tab->table[i].key != NULL) {
+            printf("%3d. slot=%d dist=%d key=%s\n", count, i, distance(tab, i), tab->table[i].key);
+            count++;
         }
     }
 }
 
 int hash_name_exists(hash_table_t* tab, const char* key) {
 
-    int slot = find_slot(tab, key);
-
-    if(tab->table[slot] != NULL && tab->table[slot]->key != NULL) {
-        if(strcmp(tab->table[slot]->key, key) == 0) {
-            return 1;
-        }
-    }
-
-    return 0;
+    return find_slot(tab, key) >= 0;
 }
 
 
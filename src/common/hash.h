@@ -4,20 +4,25 @@
 #ifndef _HASH_H_
 #define _HASH_H_
 
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * A bucket holds its entry, with the full hash and the length of the key
+ * so that most probes never look at the key itself. An empty bucket has a
+ * NULL key.
+ */
 typedef struct {
     const char* key;
     void* data;
+    uint32_t hash;
+    uint32_t len;
 } _hash_node_t;
 
-/*
- * If a node's key is NULL, but the bucket pointer in the table
- * is not NULL, then the bucket is a tombstone.
- */
 typedef struct {
-    _hash_node_t** table;
+    _hash_node_t* table;
     int cap;
     int count;
-    int tombstones;
 } hash_table_t;
 
 
@@ -28,6 +33,8 @@ int find_hashtable(hash_table_t* tab, const char* key, void** data);
 void remove_hashtable(hash_table_t* tab, const char* key);
 int hash_name_exists(hash_table_t* tab, const char* key);
 
+uint32_t hash_bytes(const void* key, size_t len);
+
 void dump_hashtable(hash_table_t* tab);
 
 #endif /* _HASH_H_ */
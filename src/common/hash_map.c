@@ -0,0 +1,245 @@
+/*
+ * Hash map with binary keys of a fixed size.
+ *
+ * This is for the keys that are not names: numbers, pairs of numbers and
+ * bit sets. The entries are stored in the table with the hash of their key
+ * and are placed with Robin Hood probing, the same as the string table in
+ * hash.c. A pointer to a key or a value is good until the map is changed.
+ *
+ * Every entry is a header, then the key and then the value, each of them
+ * starting on an 8 byte boundary.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "hash.h"
+#include "hash_map.h"
+#include "alloc.h"
+
+typedef struct {
+    uint32_t hash;
+    uint32_t used;
+} _map_entry_t;
+
+#define ALIGN8(n) (((n) + 7) & ~(size_t)7)
+
+static inline unsigned char* entry_of(hash_map_t* map, int slot) {
+
+    return &map->table[(size_t)slot * map->entry_size];
+}
+
+static inline void* key_of(unsigned char* entry) {
+
+    return entry + sizeof(_map_entry_t);
+}
+
+static inline void* value_of(hash_map_t* map, unsigned char* entry) {
+
+    return entry + sizeof(_map_entry_t) + ALIGN8(map->key_size);
+}
+
+static inline uint32_t hash_key(hash_map_t* map, const void* key) {
+
+    return (map->hash != NULL) ? map->hash(key, map->key_size) : hash_bytes(key, map->key_size);
+}
+
+static inline int equal_key(hash_map_t* map, const void* a, const void* b) {
+
+    return (map->equal != NULL) ? map->equal(a, b, map->key_size) : memcmp(a, b, map->key_size) == 0;
+}
+
+// how far the entry in the slot is from its home slot
+static inline int distance(hash_map_t* map, int slot) {
+
+    _map_entry_t* e = (_map_entry_t*)entry_of(map, slot);
+    return (slot - (int)(e->hash & (map->cap - 1))) & (map->cap - 1);
+}
+
+static int find_slot(hash_map_t* map, const void* key, uint32_t hash) {
+
+    int mask = map->cap - 1;
+    int slot = hash & mask;
+
+    for(int dist = 0;; dist++) {
+        unsigned char* entry = entry_of(map, slot);
+        _map_entry_t* e = (_map_entry_t*)entry;
+        if(!e->used || dist > distance(map, slot))
+            return -1;
+        if(e->hash == hash && equal_key(map, key_of(entry), key))
+            return slot;
+        slot = (slot + 1) & mask;
+    }
+}
+
+/*
+ * Place the entry that is in the first spare entry. The entries that it
+ * moves along are carried in the two spare entries in turn. Returns the
+ * slot that the entry was put in.
+ */
+static int place_entry(hash_map_t* map) {
+
+    size_t size = map->entry_size;
+    unsigned char* carry = map->spare;
+    unsigned char* other = map->spare + size;
+    int mask = map->cap - 1;
+    int slot = ((_map_entry_t*)carry)->hash & mask;
+    int dist = 0;
+    int placed = -1;
+
+    for(;;) {
+        unsigned char* entry = entry_of(map, slot);
+        if(!((_map_entry_t*)entry)->used) {
+            memcpy(entry, carry, size);
+            return (placed < 0) ? slot : placed;
+        }
+
+        int d = distance(map, slot);
+        if(d < dist) {
+            memcpy(other, entry, size);
+            memcpy(entry, carry, size);
+            unsigned char* tmp = carry;
+            carry = other;
+            other = tmp;
+            if(placed < 0)
+                placed = slot;
+            dist = d;
+        }
+        slot = (slot + 1) & mask;
+        dist++;
+    }
+}
+
+static void grow_map(hash_map_t* map) {
+
+    if((map->count + 1) * 4 > map->cap * 3) {
+        int oldcap = map->cap;
+        unsigned char* old = map->table;
+        map->cap <<= 1;
+        map->table = _ALLOC_ARRAY(unsigned char, (size_t)map->cap * map->entry_size);
+
+        for(int i = 0; i < oldcap; i++) {
+            unsigned char* entry = &old[(size_t)i * map->entry_size];
+            if(((_map_entry_t*)entry)->used) {
+                memcpy(map->spare, entry, map->entry_size);
+                place_entry(map);
+            }
+        }
+
+        _FREE(old);
+    }
+}
+
+hash_map_t* create_hash_map(size_t key_size, size_t value_size, map_hash_t hash, map_equal_t equal) {
+
+    hash_map_t* map = _ALLOC_TYPE(hash_map_t);
+
+    map->key_size = key_size;
+    map->value_size = value_size;
+    map->entry_size = sizeof(_map_entry_t) + ALIGN8(key_size) + ALIGN8(value_size);
+    map->hash = hash;
+    map->equal = equal;
+    map->count = 0;
+    map->cap = 0x01 << 4;
+    map->table = _ALLOC_ARRAY(unsigned char, (size_t)map->cap * map->entry_size);
+    map->spare = _ALLOC_ARRAY(unsigned char, map->entry_size * 2);
+
+    return map;
+}
+
+void destroy_hash_map(hash_map_t* map) {
+
+    if(map != NULL) {
+        _FREE(map->table);
+        _FREE(map->spare);
+        _FREE(map);
+    }
+}
+
+// remove every entry and keep the table
+void clear_hash_map(hash_map_t* map) {
+
+    memset(map->table, 0, (size_t)map->cap * map->entry_size);
+    map->count = 0;
+}
+
+// returns the value of the key, or NULL
+void* find_hash_map(hash_map_t* map, const void* key) {
+
+    int slot = find_slot(map, key, hash_key(map, key));
+
+    return (slot >= 0) ? value_of(map, entry_of(map, slot)) : NULL;
+}
+
+/*
+ * Returns the value of the key. If the key is new, the value is zero and
+ * added is set, so that the caller can fill it in. Added may be NULL.
+ */
+void* insert_hash_map(hash_map_t* map, const void* key, int* added) {
+
+    uint32_t hash = hash_key(map, key);
+    int slot = find_slot(map, key, hash);
+
+    if(added != NULL)
+        *added = (slot < 0);
+
+    if(slot < 0) {
+        grow_map(map);
+
+        memset(map->spare, 0, map->entry_size);
+        ((_map_entry_t*)map->spare)->hash = hash;
+        ((_map_entry_t*)map->spare)->used = 1;
+        memcpy(key_of(map->spare), key, map->key_size);
+
+        slot = place_entry(map);
+        map->count++;
+    }
+
+    return value_of(map, entry_of(map, slot));
+}
+
+// returns 1 if the key was in the map
+int remove_hash_map(hash_map_t* map, const void* key) {
+
+    int slot = find_slot(map, key, hash_key(map, key));
+
+    if(slot < 0)
+        return 0;
+
+    // move the entries after it back toward their home slots
+    int mask = map->cap - 1;
+    int next = (slot + 1) & mask;
+    while(((_map_entry_t*)entry_of(map, next))->used && distance(map, next) > 0) {
+        memcpy(entry_of(map, slot), entry_of(map, next), map->entry_size);
+        slot = next;
+        next = (next + 1) & mask;
+    }
+
+    memset(entry_of(map, slot), 0, map->entry_size);
+    map->count--;
+
+    return 1;
+}
+
+/*
+ * Returns the next key, and its value in value, or NULL when there are no
+ * more. The mark starts at zero. The order is the order of the table.
+ */
+void* iterate_hash_map(hash_map_t* map, int* mark, void** value) {
+
+    while(*mark < map->cap) {
+        unsigned char* entry = entry_of(map, (*mark)++);
+        if(((_map_entry_t*)entry)->used) {
+            if(value != NULL)
+                *value = value_of(map, entry);
+            return key_of(entry);
+        }
+    }
+
+    return NULL;
+}
+
+int len_hash_map(hash_map_t* map) {
+
+    return map->count;
+}
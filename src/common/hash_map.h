@@ -0,0 +1,40 @@
+/*
+ * Public interface for hash maps with binary keys.
+ */
+#ifndef _HASH_MAP_H_
+#define _HASH_MAP_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef uint32_t (*map_hash_t)(const void* key, size_t size);
+typedef int (*map_equal_t)(const void* a, const void* b, size_t size);
+
+/*
+ * Every key of a map has the same size, and every value. The entries are
+ * stored in the table itself, so nothing is allocated for one entry. The
+ * hash and equal functions may be NULL to hash and compare the bytes of
+ * the key.
+ */
+typedef struct {
+    unsigned char* table;
+    unsigned char* spare; // room to move two entries
+    size_t key_size;
+    size_t value_size;
+    size_t entry_size;
+    int cap;
+    int count;
+    map_hash_t hash;
+    map_equal_t equal;
+} hash_map_t;
+
+hash_map_t* create_hash_map(size_t key_size, size_t value_size, map_hash_t hash, map_equal_t equal);
+void destroy_hash_map(hash_map_t* map);
+void clear_hash_map(hash_map_t* map);
+void* find_hash_map(hash_map_t* map, const void* key);
+void* insert_hash_map(hash_map_t* map, const void* key, int* added);
+int remove_hash_map(hash_map_t* map, const void* key);
+void* iterate_hash_map(hash_map_t* map, int* mark, void** value);
+int len_hash_map(hash_map_t* map);
+
+#endif /* _HASH_MAP_H_ */
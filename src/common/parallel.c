@@ -0,0 +1,79 @@
+
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "alloc.h"
+#include "errors.h"
+#include "parallel.h"
+
+typedef struct {
+    parallel_task_t func;
+    void* data;
+    int num_tasks;
+    int next; // the next task to hand out
+} job_t;
+
+typedef struct {
+    job_t* job;
+    int worker;
+} worker_t;
+
+static void* run_worker(void* arg) {
+
+    worker_t* w = arg;
+    job_t* job = w->job;
+    int task;
+
+    while((task = __atomic_fetch_add(&job->next, 1, __ATOMIC_RELAXED)) < job->num_tasks)
+        job->func(job->data, task, w->worker);
+
+    return NULL;
+}
+
+int num_cpus(void) {
+
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return (n > 0) ? (int)n : 1;
+}
+
+// the number of threads that run_parallel() uses, 0 asks for one per CPU
+int num_workers(int requested, int num_tasks) {
+
+    int n = (requested > 0) ? requested : num_cpus();
+
+    if(n > num_tasks)
+        n = num_tasks;
+
+    return (n > 0) ? n : 1;
+}
+
+/*
+ * Run func for every task from 0 to num_tasks - 1 and return when they
+ * are all done. The calling thread is worker zero, so with one worker
+ * nothing is started.
+ */
+void run_parallel(int workers, int num_tasks, parallel_task_t func, void* data) {
+
+    job_t job = { func, data, num_tasks, 0 };
+    int n = num_workers(workers, num_tasks);
+    worker_t* w = _ALLOC_ARRAY(worker_t, n);
+    pthread_t* threads = _ALLOC_ARRAY(pthread_t, n);
+
+    for(int i = 0; i < n; i++)
+        w[i] = (worker_t){ &job, i };
+
+    for(int i = 1; i < n; i++) {
+        int err = pthread_create(&threads[i], NULL, run_worker, &w[i]);
+        if(err != 0)
+            FATAL("internal error: cannot start a thread: %s", strerror(err));
+    }
+
+    run_worker(&w[0]);
+
+    for(int i = 1; i < n; i++)
+        pthread_join(threads[i], NULL);
+
+    _FREE(w);
+    _FREE(threads);
+}
@@ -0,0 +1,16 @@
+/*
+ * Run independent tasks on a number of threads. The tasks are handed out
+ * one at a time from a shared counter, so a thread that finishes early
+ * takes the next task instead of waiting for the others.
+ */
+#ifndef _PARALLEL_H_
+#define _PARALLEL_H_
+
+// worker is from 0 to the number of workers - 1, for per-thread state
+typedef void (*parallel_task_t)(void* data, int task, int worker);
+
+int num_cpus(void);
+int num_workers(int requested, int num_tasks);
+void run_parallel(int workers, int num_tasks, parallel_task_t func, void* data);
+
+#endif /* _PARALLEL_H_ */
@@ -1,4 +1,6 @@
 
+#include <string.h>
+
 #include "alloc.h"
 #include "pointer_list.h"
 
@@ -22,6 +24,7 @@ pointer_list_t* create_ptr_list(void) {
     ptr->cap = 1 << 3;
     ptr->buffer = _ALLOC_ARRAY(void*, ptr->cap);
     ptr->is_sorted = false;
+    ptr->index = NULL;
 
     return ptr;
 }
@@ -29,11 +32,21 @@ pointer_list_t* create_ptr_list(void) {
 void destroy_ptr_list(pointer_list_t* lst) {
 
     if(lst != NULL) {
+        destroy_hash_map(lst->index);
         _FREE(lst->buffer);
         _FREE(lst);
     }
 }
 
+// remove every item and keep the buffer
+void clear_ptr_list(pointer_list_t* lst) {
+
+    lst->len = 0;
+    lst->is_sorted = false;
+    destroy_hash_map(lst->index);
+    lst->index = NULL;
+}
+
 void append_ptr_list(pointer_list_t* lst, void* ptr) {
 
     if(lst->len + 1 > lst->cap) {
@@ -44,6 +57,9 @@ void append_ptr_list(pointer_list_t* lst, void* ptr) {
     lst->buffer[lst->len] = ptr;
     lst->len++;
     lst->is_sorted = false;
+
+    if(lst->index != NULL)
+        insert_hash_map(lst->index, &ptr, NULL);
 }
 
 void* index_ptr_list(pointer_list_t* lst, int index) {
@@ -69,6 +85,11 @@ void* pop_ptr_list(pointer_list_t* lst) {
     if(lst->len > 0) {
         ptr = lst->buffer[lst->len - 1];
         lst->len--;
+
+        // an equal item may still be in the list, so the index is made
+        // again when it is needed
+        destroy_hash_map(lst->index);
+        lst->index = NULL;
     }
 
     return ptr;
@@ -104,18 +125,63 @@ int len_ptr_list(pointer_list_t* lst) {
     return (int)lst->len;
 }
 
-// bubble sort
+#define SORT_RUN 16
+
+static void insertion_sort(void** buffer, int len, int (*comp_func)(void*, void*)) {
+
+    for(int i = 1; i < len; i++) {
+        void* item = buffer[i];
+        int j = i;
+        while(j > 0 && comp_func(buffer[j - 1], item) > 0) {
+            buffer[j] = buffer[j - 1];
+            j--;
+        }
+        buffer[j] = item;
+    }
+}
+
+/*
+ * Stable merge sort. Short runs are sorted in place first, then the runs
+ * are merged back and forth between the list and a scratch buffer.
+ */
 void sort_ptr_list(pointer_list_t* lst, int (*comp_func)(void*, void*)) {
 
-    for(int step = 0; step < lst->len - 1; step++) {
-        for(int i = 0; i < lst->len - step - 1; i++) {
-            if(comp_func(lst->buffer[i], lst->buffer[i + 1]) > 0) {
-                void* tmp = lst->buffer[i];
-                lst->buffer[i] = lst->buffer[i + 1];
-                lst->buffer[i + 1] = tmp;
+    int len = lst->len;
+
+    for(int i = 0; i < len; i += SORT_RUN)
+        insertion_sort(&lst->buffer[i], (len - i < SORT_RUN) ? len - i : SORT_RUN, comp_func);
+
+    if(len > SORT_RUN) {
+        void** from = lst->buffer;
+        void** to = _ALLOC_ARRAY(void*, len);
+
+        for(int width = SORT_RUN; width < len; width <<= 1) {
+            for(int lo = 0; lo < len; lo += width << 1) {
+                int mid = (lo + width < len) ? lo + width : len;
+                int hi = (mid + width < len) ? mid + width : len;
+                int i = lo, j = mid, k = lo;
+
+                while(i < mid && j < hi)
+                    to[k++] = (comp_func(from[i], from[j]) <= 0) ? from[i++] : from[j++];
+                while(i < mid)
+                    to[k++] = from[i++];
+                while(j < hi)
+                    to[k++] = from[j++];
             }
+
+            void** tmp = from;
+            from = to;
+            to = tmp;
+        }
+
+        if(from != lst->buffer) {
+            memcpy(lst->buffer, from, len * sizeof(void*));
+            _FREE(from);
         }
+        else
+            _FREE(to);
     }
+
     lst->is_sorted = true;
 }
 
@@ -168,3 +234,27 @@ pointer_list_t* copy_ptr_list(pointer_list_t* lst) {
 
     return ptr;
 }
+
+/*
+ * Append the pointer if there is not an equal one in the list already,
+ * and return 1 if it was added. The first call makes a hash index of the
+ * list, which is kept up to date from then on, so every call to this on
+ * one list has to give the same hash and equal functions. They are given
+ * the address of an item. If they are NULL, the pointers are compared.
+ */
+int add_ptr_list(pointer_list_t* lst, void* ptr, map_hash_t hash, map_equal_t equal) {
+
+    if(lst->index == NULL) {
+        lst->index = create_hash_map(sizeof(void*), 0, hash, equal);
+        for(int i = 0; i < lst->len; i++)
+            insert_hash_map(lst->index, &lst->buffer[i], NULL);
+    }
+
+    int added;
+    insert_hash_map(lst->index, &ptr, &added);
+
+    if(added)
+        append_ptr_list(lst, ptr);
+
+    return added;
+}
@@ -4,15 +4,19 @@
 #include <stddef.h>
 #include <stdbool.h>
 
+#include "hash_map.h"
+
 typedef struct _ptr_list_t_ {
     void** buffer;
     int len;
     int cap;
     bool is_sorted;
+    hash_map_t* index; // items of the list, made by add_ptr_list()
 } pointer_list_t;
 
 pointer_list_t* create_ptr_list(void);
 void destroy_ptr_list(pointer_list_t* lst);
+void clear_ptr_list(pointer_list_t* lst);
 void append_ptr_list(pointer_list_t* lst, void* ptr);
 void* index_ptr_list(pointer_list_t* lst, int index);
 void push_ptr_list(pointer_list_t* lst, void* ptr);
@@ -24,5 +28,6 @@ void sort_ptr_list(pointer_list_t* lst, int (*comp_func)(void*, void*));
 void* find_ptr_list(pointer_list_t* lst, void* key, int (*comp_func)(void*, void*));
 int find_ptr_list_idx(pointer_list_t* lst, void* key, int (*comp_func)(void*, void*));
 pointer_list_t* copy_ptr_list(pointer_list_t* lst);
+int add_ptr_list(pointer_list_t* lst, void* ptr, map_hash_t hash, map_equal_t equal);
 
 #endif /* _POINTER_LIST_H_ */
@@ -6,12 +6,53 @@
 #include "alloc.h"
 #include "string_buffer.h"
 
+// make room for need bytes, counting the terminator
+static void reserve(string_t* buf, int need) {
+
+    if(need <= buf->cap)
+        return;
+
+    int cap = buf->cap;
+    while(cap < need)
+        cap <<= 1;
+
+    if(buf->buffer == buf->local) {
+        buf->buffer = _ALLOC_ARRAY(char, cap);
+        memcpy(buf->buffer, buf->local, buf->len + 1);
+    }
+    else
+        buf->buffer = _REALLOC_ARRAY(buf->buffer, char, cap);
+
+    buf->cap = cap;
+}
+
+static void append_string_len(string_t* buf, const char* str, int len) {
+
+    reserve(buf, buf->len + len + 1);
+    memcpy(&buf->buffer[buf->len], str, len);
+    buf->len += len;
+    buf->buffer[buf->len] = '\0';
+}
+
+static void append_string_va(string_t* buf, const char* fmt, va_list args) {
+
+    va_list copy;
+
+    va_copy(copy, args);
+    int len = vsnprintf(NULL, 0, fmt, copy);
+    va_end(copy);
+
+    reserve(buf, buf->len + len + 1);
+    vsnprintf(&buf->buffer[buf->len], len + 1, fmt, args);
+    buf->len += len;
+}
+
 string_t* create_string(const char* str) {
 
     string_t* ptr = _ALLOC_TYPE(string_t);
-    ptr->cap = 1 << 3;
+    ptr->buffer = ptr->local;
+    ptr->cap = STRING_LOCAL;
     ptr->len = 0;
-    ptr->buffer = _ALLOC_ARRAY(char, ptr->cap);
 
     if(str != NULL)
         append_string(ptr, str);
@@ -22,43 +63,27 @@ string_t* create_string(const char* str) {
 string_t* create_string_fmt(const char* fmt, ...) {
 
     va_list args;
+    string_t* ptr = create_string(NULL);
 
     va_start(args, fmt);
-    size_t len = vsnprintf(NULL, 0, fmt, args);
-    va_end(args);
-
-    char* str = _ALLOC(len + 1);
-
-    va_start(args, fmt);
-    vsprintf(str, fmt, args);
+    append_string_va(ptr, fmt, args);
     va_end(args);
 
-    string_t* ptr = create_string(str);
-    _FREE(str);
-
     return ptr;
 }
 
 void destroy_string(string_t* buf) {
 
     if(buf != NULL) {
-        _FREE(buf->buffer);
+        if(buf->buffer != buf->local)
+            _FREE(buf->buffer);
         _FREE(buf);
     }
 }
 
 string_t* append_string(string_t* buf, const char* str) {
 
-    int len = strlen(str);
-    if(len + buf->len + 1 > buf->cap) {
-        while(len + buf->len + 1 > buf->cap)
-            buf->cap <<= 1;
-        buf->buffer = _REALLOC_ARRAY(buf->buffer, char, buf->cap);
-    }
-
-    strcat(buf->buffer, str);
-    buf->len = strlen(buf->buffer);
-
+    append_string_len(buf, str, strlen(str));
     return buf;
 }
 
@@ -67,30 +92,16 @@ string_t* append_string_fmt(string_t* buf, const char* fmt, ...) {
     va_list args;
 
     va_start(args, fmt);
-    size_t len = vsnprintf(NULL, 0, fmt, args);
+    append_string_va(buf, fmt, args);
     va_end(args);
 
-    char* str = _ALLOC(len + 1);
-
-    va_start(args, fmt);
-    vsprintf(str, fmt, args);
-    va_end(args);
-
-    append_string(buf, str);
-    _FREE(str);
-
     return buf;
 }
 
 string_t* append_string_char(string_t* buf, int ch) {
 
-    if(buf->len + 1 > buf->cap) {
-        buf->cap <<= 1;
-        buf->buffer = _REALLOC_ARRAY(buf->buffer, char, buf->cap);
-    }
-
-    buf->buffer[buf->len] = (char)ch;
-    buf->len++;
+    reserve(buf, buf->len + 2);
+    buf->buffer[buf->len++] = (char)ch;
     buf->buffer[buf->len] = '\0';
 
     return buf;
@@ -98,7 +109,8 @@ string_t* append_string_char(string_t* buf, int ch) {
 
 string_t* append_string_str(string_t* buf, string_t* str) {
 
-    return append_string(buf, str->buffer);
+    append_string_len(buf, str->buffer, str->len);
+    return buf;
 }
 
 void clear_string(string_t* buf) {
@@ -134,25 +146,30 @@ string_t* strip_char(string_t* buf, int ch) {
 
     strip_space(buf);
 
-    char* temp;
-    while((temp = strrchr(buf->buffer, ch)) != NULL)
-        memmove(temp, temp + 1, strlen(temp) + 1);
+    int len = 0;
+    for(int i = 0; i < buf->len; i++)
+        if(buf->buffer[i] != ch)
+            buf->buffer[len++] = buf->buffer[i];
 
-    buf->len = strlen(buf->buffer);
+    buf->buffer[len] = '\0';
+    buf->len = len;
 
     return buf;
 }
 
 string_t* strip_space(string_t* buf) {
 
-    int len;
-    for(len = strlen(buf->buffer); (isspace(buf->buffer[len]) || buf->buffer[len] == 0) && len >= 0; len--)
-        buf->buffer[len] = '\0';
+    int end = buf->len;
+    while(end > 0 && isspace((unsigned char)buf->buffer[end - 1]))
+        end--;
 
-    for(len = 0; buf->buffer[len] != '\0' && isspace(buf->buffer[len]); len++) {
-    }
+    int start = 0;
+    while(start < end && isspace((unsigned char)buf->buffer[start]))
+        start++;
 
-    memmove(&buf->buffer[0], &buf->buffer[len], strlen(&buf->buffer[len]) + 1);
+    memmove(&buf->buffer[0], &buf->buffer[start], end - start);
+    buf->len = end - start;
+    buf->buffer[buf->len] = '\0';
 
     return buf;
 }
@@ -160,7 +177,7 @@ string_t* strip_space(string_t* buf) {
 string_t* upcase(string_t* buf) {
 
     for(int i = 0; buf->buffer[i] != '\0'; i++)
-        buf->buffer[i] = toupper(buf->buffer[i]);
+        buf->buffer[i] = toupper((unsigned char)buf->buffer[i]);
 
     return buf;
 }
@@ -168,7 +185,7 @@ string_t* upcase(string_t* buf) {
 string_t* downcase(string_t* buf) {
 
     for(int i = 0; buf->buffer[i] != '\0'; i++)
-        buf->buffer[i] = tolower(buf->buffer[i]);
+        buf->buffer[i] = tolower((unsigned char)buf->buffer[i]);
 
     return buf;
 }
@@ -234,8 +251,8 @@ string_t* convert(string_t* str) {
     char tmp[64];
 
     for(int i = 0; str->buffer[i] != '\0'; i++) {
-        if(!ispunct(str->buffer[i]) || str->buffer[i] == '_')
-            append_string_char(buf, toupper(str->buffer[i]));
+        if(!ispunct((unsigned char)str->buffer[i]) || str->buffer[i] == '_')
+            append_string_char(buf, toupper((unsigned char)str->buffer[i]));
         else {
             append_string(buf, conv_char(str->buffer[i], tmp, sizeof(tmp)));
             if(str->buffer[i + 1] != '\0')
@@ -247,7 +264,10 @@ string_t* convert(string_t* str) {
 
 string_t* copy_string(string_t* buf) {
 
-    return create_string(buf->buffer);
+    string_t* ptr = create_string(NULL);
+    append_string_len(ptr, buf->buffer, buf->len);
+
+    return ptr;
 }
 
 void emit_string(FILE* fp, string_t* ptr) {
@@ -260,17 +280,8 @@ void emit_string_fmt(FILE* fp, const char* fmt, ...) {
     va_list args;
 
     va_start(args, fmt);
-    size_t len = vsnprintf(NULL, 0, fmt, args);
+    vfprintf(fp, fmt, args);
     va_end(args);
-
-    char* str = _ALLOC(len + 1);
-
-    va_start(args, fmt);
-    vsprintf(str, fmt, args);
-    va_end(args);
-
-    fputs(str, fp);
-    _FREE(str);
 }
 
 #if 0
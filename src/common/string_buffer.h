@@ -5,10 +5,18 @@
 #include <stdio.h>
 #include <stddef.h>
 
+// strings this long, with the terminator, are kept inside the string_t
+#define STRING_LOCAL 24
+
+/*
+ * The buffer points at local until the string outgrows it. The length is
+ * always kept, so nothing has to look for the end of the string.
+ */
 typedef struct {
     char* buffer;
     int len;
     int cap;
+    char local[STRING_LOCAL];
 } string_t;
 
 string_t* create_string(const char* str);
@@ -4,6 +4,7 @@
 #include "string_list.h"
 #include "pointer_list.h"
 #include "string_buffer.h"
+#include "hash.h"
 
 string_list_t* create_string_list(void) {
 
@@ -58,19 +59,25 @@ int find_string_list(string_list_t* lst, string_t* key) {
 }
 
 
+static uint32_t hash_func(const void* key, size_t size) {
+
+    (void)size;
+    string_t* str = *(string_t* const*)key;
+    return hash_bytes(str->buffer, str->len);
+}
+
+static int equal_func(const void* a, const void* b, size_t size) {
+
+    (void)size;
+    return comp_string(*(string_t* const*)a, *(string_t* const*)b) == 0;
+}
+
 /*
  * Add to the string into the list if it does not already exist.
  */
 void add_string_list(string_list_t* lst, string_t* str) {
 
-    int mark = 0;
-    string_t* ptr;
-
-    while(NULL != (ptr = iterate_string_list(lst, &mark)))
-        if(comp_string(ptr, str) == 0)
-            return;
-
-    append_string_list(lst, str);
+    add_ptr_list((pointer_list_t*)lst, (void*)str, hash_func, equal_func);
 }
 
 string_list_t* split_string(const char* str, int ch) {
@@ -0,0 +1,92 @@
+/*
+ * Typed vectors. DECLARE_VECTOR(name, type) makes vec_name_t, which holds
+ * items of the type, and inline functions named vec_name_push() and so on
+ * to use it. Unlike array_t, the size of an item is known when the code is
+ * compiled, and items are passed and returned by value, so that nothing
+ * keeps a pointer into a buffer that may move.
+ *
+ * A vector that is all zero is empty and ready to use.
+ *
+ *     DECLARE_VECTOR(int, int)
+ *
+ *     vec_int_t v = VECTOR_INIT;
+ *     vec_int_push(&v, 42);
+ *     int n = vec_int_pop(&v);
+ *     vec_int_destroy(&v);
+ */
+#ifndef _VECTOR_H_
+#define _VECTOR_H_
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "alloc.h"
+#include "errors.h"
+
+#define VECTOR_INIT { NULL, 0, 0 }
+
+#define DECLARE_VECTOR(name, type)                                                          \
+    typedef struct {                                                                        \
+        type* items;                                                                        \
+        size_t len;                                                                         \
+        size_t cap;                                                                         \
+    } vec_##name##_t;                                                                       \
+                                                                                            \
+    static inline void vec_##name##_destroy(vec_##name##_t* v) {                            \
+        _FREE(v->items);                                                                    \
+        v->items = NULL;                                                                    \
+        v->len = v->cap = 0;                                                                \
+    }                                                                                       \
+                                                                                            \
+    /* make room for at least cap items */                                                  \
+    static inline void vec_##name##_reserve(vec_##name##_t* v, size_t cap) {                \
+        if(cap > v->cap) {                                                                  \
+            size_t n = (v->cap > 0) ? v->cap : 8;                                           \
+            while(n < cap)                                                                  \
+                n <<= 1;                                                                    \
+            v->items = _REALLOC_ARRAY(v->items, type, n);                                   \
+            v->cap = n;                                                                     \
+        }                                                                                   \
+    }                                                                                       \
+                                                                                            \
+    /* give back the room that the items do not use */                                      \
+    static inline void vec_##name##_shrink(vec_##name##_t* v) {                             \
+        if(v->len == 0)                                                                     \
+            vec_##name##_destroy(v);                                                        \
+        else if(v->len < v->cap) {                                                          \
+            v->items = _REALLOC_ARRAY(v->items, type, v->len);                              \
+            v->cap = v->len;                                                                \
+        }                                                                                   \
+    }                                                                                       \
+                                                                                            \
+    static inline void vec_##name##_push(vec_##name##_t* v, type item) {                    \
+        if(v->len == v->cap)                                                                \
+            vec_##name##_reserve(v, v->len + 1);                                            \
+        v->items[v->len++] = item;                                                          \
+    }                                                                                       \
+                                                                                            \
+    static inline type vec_##name##_pop(vec_##name##_t* v) {                                \
+        if(v->len == 0)                                                                     \
+            FATAL("internal error: pop from an empty vec_" #name "_t");                     \
+        return v->items[--v->len];                                                          \
+    }                                                                                       \
+                                                                                            \
+    /* the pointer is good until the vector grows */                                        \
+    static inline type* vec_##name##_at(vec_##name##_t* v, size_t index) {                 \
+        return &v->items[index];                                                            \
+    }                                                                                       \
+                                                                                            \
+    static inline type* vec_##name##_last(vec_##name##_t* v) {                              \
+        return (v->len > 0) ? &v->items[v->len - 1] : NULL;                                 \
+    }                                                                                       \
+                                                                                            \
+    static inline size_t vec_##name##_len(const vec_##name##_t* v) {                        \
+        return v->len;                                                                      \
+    }                                                                                       \
+                                                                                            \
+    static inline void vec_##name##_clear(vec_##name##_t* v) {                              \
+        v->len = 0;                                                                         \
+    }
+
+#endif /* _VECTOR_H_ */
@@ -2,10 +2,17 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
 
 #include "parser.h"
+#include "states.h"
+#include "tokens.h"
 #include "cmdline.h"
 #include "trace.h"
+#include "fileio.h"
+#include "errors.h"
+#include "alloc.h"
+#include "parallel.h"
 
 int find_dumper(const char* name) {
 
@@ -18,22 +25,87 @@ void cmdline(int argc, char** argv, char** env) {
     add_cmdline('v', "verbosity", "verbosity", "From 0 to 10. Print more information", "0", NULL, CMD_NUM | CMD_ARGS);
     add_cmdline('p', "path", "path", "Add to the import path", "", NULL, CMD_STR | CMD_ARGS | CMD_LIST);
     add_cmdline('d', "dump", "dump", "Dump text as the parser is generated", "", NULL, CMD_STR | CMD_ARGS | CMD_LIST);
+    add_cmdline('f', "format", "format", "Output format: heap, comb or code", "heap", NULL, CMD_STR | CMD_ARGS);
+    add_cmdline('o', "output", "output", "Output file name, for a single input file", "", NULL, CMD_STR | CMD_ARGS);
+    add_cmdline('j', "jobs", "jobs", "Number of files to compile at once, 0 for one per CPU", "1", NULL, CMD_NUM | CMD_ARGS);
+    add_cmdline('t', "threads", "threads", "Number of threads for each file, 0 for one per CPU", "1", NULL, CMD_NUM | CMD_ARGS);
     add_cmdline('h', "help", NULL, "Print this helpful information", NULL, cmdline_help, CMD_NONE);
     add_cmdline('V', "version", NULL, "Show the program version", NULL, cmdline_vers, CMD_NONE);
     add_cmdline(0, NULL, NULL, NULL, NULL, NULL, CMD_DIV);
-    add_cmdline(0, NULL, "files", "File name(s) to input", NULL, NULL, CMD_REQD | CMD_ANON);
+    add_cmdline(0, NULL, "files", "File name(s) to input", NULL, NULL, CMD_REQD | CMD_ANON | CMD_LIST);
 
     parse_cmdline(argc, argv, env);
 
     INIT_TRACE(NULL);
 }
 
+typedef struct {
+    const char** files;
+    int* errors;
+} build_t;
+
+// compile one grammar, each worker has its own context and output
+static void compile_grammar(void* data, int task, int worker) {
+
+    build_t* build = data;
+    const char* fname = build->files[task];
+    (void)worker;
+
+    compile_t* ctx = init_parser(fname);
+    if(ctx == NULL) {
+        fprintf(stderr, "cannot open input file \"%s\": %s\n", fname, strerror(errno));
+        build->errors[task] = 1;
+        return;
+    }
+
+    int errors = parser(ctx);
+    if(errors == 0)
+        errors = make_states(get_parser_state(ctx));
+    destroy_parser(ctx);
+
+    build->errors[task] = errors;
+}
+
 int main(int argc, char** argv, char** env) {
 
     cmdline(argc, argv, env);
 
-    init_parser();
-    parser();
+    string_t* str;
+    int mark = 0;
+    int num_files = 0;
+    while(NULL != iterate_cmd_opt("files", &mark))
+        num_files++;
+
+    const char* output = raw_string(get_cmd_opt("output"));
+    if(num_files > 1 && output != NULL && output[0] != '\0') {
+        fprintf(stderr, "an output file name can only be given for a single input file\n");
+        cmdline_help();
+    }
+
+    // the file search is not thread safe, so every name is found first
+    build_t build;
+    build.files = _ALLOC_ARRAY(const char*, num_files);
+    build.errors = _ALLOC_ARRAY(int, num_files);
+    mark = 0;
+    for(int i = 0; NULL != (str = iterate_cmd_opt("files", &mark)); i++)
+        build.files[i] = find_file(raw_string(str), ".g");
+
+    int jobs = (int)strtol(raw_string(get_cmd_opt("jobs")), NULL, 10);
+    run_parallel(jobs, num_files, compile_grammar, &build);
+
+    int errors = 0;
+    for(int i = 0; i < num_files; i++)
+        if(build.errors[i] != 0)
+            errors++;
+
+    // find_file() returns a copy of the name when it found the file
+    mark = 0;
+    for(int i = 0; NULL != (str = iterate_cmd_opt("files", &mark)); i++)
+        if(build.files[i] != raw_string(str))
+            _FREE(build.files[i]);
+
+    _FREE(build.files);
+    _FREE(build.errors);
 
-    return 0;
+    return (errors == 0) ? 0 : 1;
 }
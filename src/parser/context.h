@@ -0,0 +1,31 @@
+/*
+ * The state of one grammar while it is read. The scanner, the tokens and
+ * the parser keep nothing in globals, so any number of grammars can be
+ * read at once, each with its own context.
+ */
+#ifndef _CONTEXT_H_
+#define _CONTEXT_H_
+
+#include <stddef.h>
+
+#include "alloc.h"
+#include "tokens.h"
+#include "parser.h"
+
+struct _compile_t_ {
+    const char* fname;
+    void* scanner;      // yyscan_t
+    void* input_buffer; // YY_BUFFER_STATE
+    char* input;        // the mapped grammar file
+    size_t input_size;
+    token_t* token; // the current token
+    arena_t* scan_arena;
+    arena_t* grammar_arena;
+    int depth;   // nesting of braces in a code block
+    char* block; // start of the code block in the input
+    int errors;
+    pointer_list_t* postfix; // the rule that expression() is reading
+    parser_state_t* pstate;
+};
+
+#endif /* _CONTEXT_H_ */
@@ -0,0 +1,31 @@
+#ifndef _EMIT_H_
+#define _EMIT_H_
+
+#include "states.h"
+#include "pgen_heap.h"
+
+/*
+ * The state heap as it will be written. Every back end works from this,
+ * so they all agree on the numbers of the symbols and the states.
+ */
+typedef struct {
+    pgen_heap_header_t header;
+    pgen_symbol_t* symbols;
+    pgen_state_t* states;
+    char* strings;
+    uint32_t cap_strings;
+    pgen_dispatch_t* dispatch;
+    uint32_t* dispatch_words;
+    int cap_dispatch_words;
+    uint32_t* first_sets;
+    int* sym_map;   // DFA symbol -> heap symbol
+    int* state_map; // DFA state -> first heap state
+} heap_image_t;
+
+heap_image_t* create_heap_image(dfa_t* dfa, first_sets_t* sets);
+void destroy_heap_image(heap_image_t* img);
+int emit_heap(heap_image_t* img, const char* fname);
+int emit_comb(heap_image_t* heap, dfa_t* dfa, const char* fname);
+int emit_code(heap_image_t* img, parser_state_t* pstate, const char* fname);
+
+#endif /* _EMIT_H_ */
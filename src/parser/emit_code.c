@@ -0,0 +1,482 @@
+/*
+ * Emit the state heap as straight line C code.
+ *
+ * Every heap state becomes a label and every transition becomes a goto,
+ * so the C compiler sees the whole state machine and can predict the
+ * branches of each state separately. A run of terminal tests in the same
+ * DFA state becomes a switch on the token. Code blocks are pasted in
+ * where they are matched.
+ *
+ * The generated parser does exactly what the runtime library does with
+ * the same heap. Backing up to a choice and returning from a rule are
+ * the only places where the next state is not known when the code is
+ * generated. Those go through a table of label addresses when the
+ * compiler supports computed goto, and through a switch when it does not.
+ * The memo works as in the runtime library, and a call that is found in
+ * it goes straight to the place the call returns to.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+
+#include "alloc.h"
+#include "errors.h"
+#include "emit.h"
+
+static void emit_goto(FILE* fp, uint32_t state) {
+
+    if(state == PGEN_STATE_NO_MATCH)
+        fputs("goto fail;", fp);
+    else if(state == PGEN_STATE_MATCH)
+        fputs("goto match;", fp);
+    else
+        emit_string_fmt(fp, "goto S%u;", state);
+}
+
+static int is_terminal(heap_image_t* img, uint32_t state) {
+
+    uint32_t sym = img->states[state].terminal;
+    return sym > 0 && sym <= img->header.num_terminals;
+}
+
+static const char* heap_symbol_name(heap_image_t* img, uint32_t sym) {
+
+    return &img->strings[img->symbols[sym].name];
+}
+
+static void emit_match_token(FILE* fp, pgen_state_t* st) {
+
+    if(st->no_match_state != PGEN_STATE_NO_MATCH)
+        emit_string_fmt(fp, "PUSH_CHOICE(%u, pos); ", st->no_match_state);
+    fputs("if(++pos > farthest) farthest = pos; ", fp);
+    emit_goto(fp, st->match_state);
+}
+
+static void emit_state(FILE* fp, heap_image_t* img, uint32_t n) {
+
+    pgen_state_t* st = &img->states[n];
+    uint32_t sym = st->terminal;
+    uint32_t first_rule = img->header.num_terminals + 1;
+    uint32_t first_action = first_rule + img->header.num_rules;
+
+    emit_string_fmt(fp, "S%u:\n", n);
+
+    if(sym == 0) {
+        fputs("    ", fp);
+        if(st->no_match_state != PGEN_STATE_NO_MATCH)
+            emit_string_fmt(fp, "PUSH_CHOICE(%u, pos); ", st->no_match_state);
+        emit_goto(fp, st->match_state);
+        fputs("\n", fp);
+    }
+    else if(st->dispatch != 0) {
+        // the dispatch becomes a switch, which the compiler lays out as it likes
+        pgen_dispatch_t* d = &img->dispatch[st->dispatch - 1];
+        uint32_t* words = &img->dispatch_words[d->words];
+
+        fputs("    if(pos < num_tokens) {\n        switch(tokens[pos]) {\n", fp);
+        for(uint32_t k = 0; k < d->count; k++) {
+            uint32_t target = (d->type == PGEN_DISPATCH_DENSE) ? words[k] : words[d->count + k];
+            if(target != 0) {
+                emit_string_fmt(fp, "            case %s: ", heap_symbol_name(img, img->states[target].terminal));
+                emit_match_token(fp, &img->states[target]);
+                fputs("\n", fp);
+            }
+        }
+        fputs("        }\n    }\n    ", fp);
+        emit_goto(fp, d->miss);
+        fputs("\n", fp);
+    }
+    else if(sym < first_rule) {
+        // a short run of terminal tests in one DFA state is a switch too
+        uint32_t last = n;
+        while(img->states[last].no_match_state == last + 1 && last + 1 < img->header.num_states
+              && is_terminal(img, last + 1))
+            last++;
+
+        if(last > n) {
+            fputs("    if(pos < num_tokens) {\n        switch(tokens[pos]) {\n", fp);
+            for(uint32_t k = n; k <= last; k++) {
+                emit_string_fmt(fp, "            case %s: ", heap_symbol_name(img, img->states[k].terminal));
+                emit_match_token(fp, &img->states[k]);
+                fputs("\n", fp);
+            }
+            fputs("        }\n    }\n    ", fp);
+            emit_goto(fp, img->states[last].no_match_state);
+            fputs("\n", fp);
+        }
+        else {
+            emit_string_fmt(fp, "    if(pos < num_tokens && tokens[pos] == %s) { ", heap_symbol_name(img, sym));
+            emit_match_token(fp, st);
+            fputs(" }\n    ", fp);
+            emit_goto(fp, st->no_match_state);
+            fputs("\n", fp);
+        }
+    }
+    else {
+        if(st->first != 0) {
+            // the token can not start this alternative
+            emit_string_fmt(fp, "    if(!IN_FIRST(%u)) ", st->first - 1);
+            emit_goto(fp, st->no_match_state);
+            fputs("\n", fp);
+        }
+
+        if(sym < first_action) {
+            emit_string_fmt(fp, "    if(parser->active[%u] == pos + 1) { GUARD_DEPENDS(%u); ", sym - first_rule,
+                            sym - first_rule);
+            emit_goto(fp, st->no_match_state);
+            fputs(" } // left recursion\n", fp);
+            emit_string_fmt(fp, "    MEMO_FIND(%u, %u);\n", n, sym - first_rule);
+            emit_string_fmt(fp, "    CALL(%u, %u); ", n, sym - first_rule);
+            emit_goto(fp, img->symbols[sym].data);
+            fputs("\n", fp);
+        }
+        else {
+            emit_string_fmt(fp, "    { %s }\n    ", &img->strings[img->symbols[sym].text]);
+            if(st->no_match_state != PGEN_STATE_NO_MATCH)
+                emit_string_fmt(fp, "PUSH_CHOICE(%u, pos); ", st->no_match_state);
+            emit_goto(fp, st->match_state);
+            fputs("\n", fp);
+        }
+    }
+}
+
+static int is_call(heap_image_t* img, uint32_t n) {
+
+    uint32_t sym = img->states[n].terminal;
+    uint32_t first_rule = img->header.num_terminals + 1;
+
+    return n >= PGEN_FIRST_STATE && sym >= first_rule && sym < first_rule + img->header.num_rules;
+}
+
+static void emit_tables(FILE* fp, heap_image_t* img) {
+
+    uint32_t num = img->header.num_states;
+
+    fputs("#ifdef PGEN_COMPUTED_GOTO\n", fp);
+    fputs("    static void* const resume_state[] = {\n        &&fail, &&match,", fp);
+    for(uint32_t n = PGEN_FIRST_STATE; n < num; n++)
+        emit_string_fmt(fp, "%s&&S%u,", (n % 8 == 0) ? "\n        " : " ", n);
+    fputs("\n    };\n", fp);
+
+    fputs("    static void* const resume_return[] = {\n        &&fail, &&fail,", fp);
+    for(uint32_t n = PGEN_FIRST_STATE; n < num; n++) {
+        fputs((n % 8 == 0) ? "\n        " : " ", fp);
+        if(is_call(img, n))
+            emit_string_fmt(fp, "&&R%u,", n);
+        else
+            fputs("&&fail,", fp);
+    }
+    fputs("\n    };\n", fp);
+
+    fputs("    static void* const resume_fail[] = {\n        &&fail, &&fail,", fp);
+    for(uint32_t n = PGEN_FIRST_STATE; n < num; n++) {
+        fputs((n % 8 == 0) ? "\n        " : " ", fp);
+        if(is_call(img, n))
+            emit_string_fmt(fp, "&&F%u,", n);
+        else
+            fputs("&&fail,", fp);
+    }
+    fputs("\n    };\n#else\n    uint32_t state;\n#endif\n", fp);
+}
+
+static void emit_dispatch(FILE* fp, heap_image_t* img) {
+
+    uint32_t num = img->header.num_states;
+
+    fputs("#ifndef PGEN_COMPUTED_GOTO\n", fp);
+    fputs("dispatch_resume_state:\n    switch(state) {\n        case 1: goto match;\n", fp);
+    for(uint32_t n = PGEN_FIRST_STATE; n < num; n++)
+        emit_string_fmt(fp, "        case %u: goto S%u;\n", n, n);
+    fputs("        default: goto fail;\n    }\n", fp);
+
+    fputs("dispatch_resume_return:\n    switch(state) {\n", fp);
+    for(uint32_t n = PGEN_FIRST_STATE; n < num; n++)
+        if(is_call(img, n))
+            emit_string_fmt(fp, "        case %u: goto R%u;\n", n, n);
+    fputs("        default: goto fail;\n    }\n", fp);
+
+    fputs("dispatch_resume_fail:\n    switch(state) {\n", fp);
+    for(uint32_t n = PGEN_FIRST_STATE; n < num; n++)
+        if(is_call(img, n))
+            emit_string_fmt(fp, "        case %u: goto F%u;\n", n, n);
+    fputs("        default: goto fail;\n    }\n#endif\n", fp);
+}
+
+// the places a call goes when the rule that it called matches or fails
+static void emit_returns(FILE* fp, heap_image_t* img) {
+
+    for(uint32_t n = PGEN_FIRST_STATE; n < img->header.num_states; n++) {
+        if(is_call(img, n)) {
+            pgen_state_t* st = &img->states[n];
+            emit_string_fmt(fp, "R%u:\n    ", n);
+            if(st->no_match_state != PGEN_STATE_NO_MATCH)
+                emit_string_fmt(fp, "PUSH_CHOICE(%u, call_pos); ", st->no_match_state);
+            emit_goto(fp, st->match_state);
+            emit_string_fmt(fp, "\nF%u:\n    ", n);
+            emit_goto(fp, st->no_match_state);
+            fputs("\n", fp);
+        }
+    }
+}
+
+static void emit_header(FILE* fp, heap_image_t* img, const char* prefix, const char* guard) {
+
+    emit_string_fmt(fp, "/*\n * Generated by pgen. Do not edit.\n */\n#ifndef %s\n#define %s\n\n", guard, guard);
+    fputs("#include <stdint.h>\n\n", fp);
+
+    emit_string_fmt(fp, "typedef enum {\n");
+    for(uint32_t s = 1; s <= img->header.num_terminals; s++)
+        emit_string_fmt(fp, "    %s = %u,\n", heap_symbol_name(img, s), s);
+    emit_string_fmt(fp, "} %s_terminal_t;\n\n", prefix);
+
+    emit_string_fmt(fp, "typedef struct _%s_parser_t_ %s_parser_t;\n\n", prefix, prefix);
+    emit_string_fmt(fp, "%s_parser_t* %s_create_parser(uint32_t depth);\n", prefix, prefix);
+    emit_string_fmt(fp, "void %s_destroy_parser(%s_parser_t* parser);\n", prefix, prefix);
+    emit_string_fmt(fp, "long %s_parse(%s_parser_t* parser, const uint32_t* tokens, uint32_t num_tokens, void* data);\n",
+                    prefix, prefix);
+    emit_string_fmt(fp, "uint32_t %s_error_pos(%s_parser_t* parser);\n", prefix, prefix);
+    emit_string_fmt(fp, "int %s_set_memo(%s_parser_t* parser, uint32_t size);\n\n", prefix, prefix);
+    emit_string_fmt(fp, "#endif /* %s */\n", guard);
+}
+
+static void emit_support(FILE* fp, heap_image_t* img, const char* prefix) {
+
+    emit_string_fmt(fp, "typedef struct {\n    uint32_t state;\n    uint32_t pos;\n    uint32_t rule;\n"
+                        "    uint32_t choice_base;\n    uint32_t saved_active;\n    uint32_t depends;\n} frame_t;\n\n");
+    emit_string_fmt(fp, "typedef struct {\n    uint32_t state;\n    uint32_t pos;\n} choice_t;\n\n");
+    emit_string_fmt(fp, "typedef struct {\n    uint32_t generation;\n    uint32_t rule;\n    uint32_t pos;\n"
+                        "    uint32_t end;\n} memo_t;\n\n");
+    emit_string_fmt(fp, "struct _%s_parser_t_ {\n    frame_t* frames;\n    uint32_t cap_frames;\n"
+                        "    choice_t* choices;\n    uint32_t cap_choices;\n    uint32_t farthest;\n"
+                        "    memo_t* memo;\n    uint32_t memo_mask;\n    uint32_t generation;\n"
+                        "    uint32_t active[%u];\n};\n\n",
+                    prefix, img->header.num_rules + 1);
+
+    emit_string_fmt(fp, "%s_parser_t* %s_create_parser(uint32_t depth) {\n\n", prefix, prefix);
+    emit_string_fmt(fp, "    %s_parser_t* parser = calloc(1, sizeof(%s_parser_t));\n", prefix, prefix);
+    fputs("    if(parser == NULL)\n        return NULL;\n\n"
+          "    if(depth < 16)\n        depth = 16;\n\n"
+          "    parser->cap_frames = depth;\n"
+          "    parser->frames = malloc(depth * sizeof(frame_t));\n"
+          "    parser->cap_choices = depth * 4;\n"
+          "    parser->choices = malloc(parser->cap_choices * sizeof(choice_t));\n\n"
+          "    if(parser->frames == NULL || parser->choices == NULL) {\n",
+          fp);
+    emit_string_fmt(fp, "        %s_destroy_parser(parser);\n        return NULL;\n    }\n\n    return parser;\n}\n\n", prefix);
+
+    emit_string_fmt(fp, "void %s_destroy_parser(%s_parser_t* parser) {\n\n", prefix, prefix);
+    fputs("    if(parser != NULL) {\n        free(parser->frames);\n        free(parser->choices);\n"
+          "        free(parser->memo);\n        free(parser);\n    }\n}\n\n",
+          fp);
+
+    emit_string_fmt(fp, "uint32_t %s_error_pos(%s_parser_t* parser) {\n\n    return parser->farthest;\n}\n\n", prefix,
+                    prefix);
+
+    emit_string_fmt(fp, "int %s_set_memo(%s_parser_t* parser, uint32_t size) {\n\n", prefix, prefix);
+    fputs("    uint32_t cap = 1;\n    while(cap <= size / 2)\n        cap <<= 1;\n\n"
+          "    free(parser->memo);\n    parser->memo = NULL;\n    parser->memo_mask = 0;\n"
+          "    if(size == 0)\n        return 1;\n\n"
+          "    parser->memo = calloc(cap, sizeof(memo_t));\n"
+          "    if(parser->memo == NULL)\n        return 0;\n\n"
+          "    parser->memo_mask = cap - 1;\n    parser->generation = 0;\n    return 1;\n}\n\n",
+          fp);
+
+    fputs("static inline memo_t* memo_slot(memo_t* memo, uint32_t mask, uint32_t rule, uint32_t pos) {\n\n"
+          "    uint32_t h = pos * 0x9e3779b1u ^ rule * 0x85ebca77u;\n"
+          "    return &memo[(h ^ (h >> 16)) & mask];\n}\n\n",
+          fp);
+
+    fputs("static int grow(void** buffer, uint32_t* cap, size_t size) {\n\n"
+          "    void* ptr = realloc(*buffer, (size_t)*cap * 2 * size);\n"
+          "    if(ptr == NULL)\n        return 0;\n\n"
+          "    *buffer = ptr;\n    *cap *= 2;\n    return 1;\n}\n\n",
+          fp);
+
+    fputs("#if defined(__GNUC__) && !defined(PGEN_NO_COMPUTED_GOTO)\n#define PGEN_COMPUTED_GOTO\n#endif\n\n"
+          "#ifdef PGEN_COMPUTED_GOTO\n#define RESUME(table, s) goto *table[s]\n#else\n"
+          "#define RESUME(table, s) \\\n    do { \\\n        state = (s); \\\n        goto dispatch_##table; \\\n"
+          "    } while(0)\n#endif\n\n",
+          fp);
+
+    fputs("#define PUSH_CHOICE(s, p) \\\n    do { \\\n"
+          "        if(num_choices >= parser->cap_choices \\\n"
+          "           && !grow((void**)&parser->choices, &parser->cap_choices, sizeof(choice_t))) \\\n"
+          "            goto out_of_memory; \\\n"
+          "        parser->choices[num_choices].state = (s); \\\n"
+          "        parser->choices[num_choices].pos = (p); \\\n"
+          "        num_choices++; \\\n    } while(0)\n\n",
+          fp);
+
+    if(img->header.num_first > 0) {
+        uint32_t words = img->header.first_words;
+        emit_string_fmt(fp, "static const uint32_t first_sets[%u][%u] = {\n", img->header.num_first, words);
+        for(uint32_t i = 0; i < img->header.num_first; i++) {
+            fputs("    {", fp);
+            for(uint32_t w = 0; w < words; w++)
+                emit_string_fmt(fp, "%s0x%08x", (w > 0) ? ", " : " ", img->first_sets[i * words + w]);
+            fputs(" },\n", fp);
+        }
+        fputs("};\n\n", fp);
+
+        emit_string_fmt(fp, "#define IN_FIRST(set) \\\n    (pos < num_tokens && tokens[pos] <= %u \\\n"
+                            "     && ((first_sets[set][tokens[pos] >> 5] >> (tokens[pos] & 31)) & 1))\n\n",
+                        img->header.num_terminals);
+    }
+
+    fputs("#define CALL(site, rule) \\\n    do { \\\n"
+          "        if(num_frames >= parser->cap_frames \\\n"
+          "           && !grow((void**)&parser->frames, &parser->cap_frames, sizeof(frame_t))) \\\n"
+          "            goto out_of_memory; \\\n"
+          "        parser->frames[num_frames++] \\\n"
+          "                = (frame_t){ (site), pos, (rule), num_choices, parser->active[rule], 0xffffffffu }; \\\n"
+          "        parser->active[rule] = pos + 1; \\\n    } while(0)\n\n",
+          fp);
+
+    fputs("#define MEMO_FIND(site, r) \\\n    do { \\\n"
+          "        if(parser->memo != NULL) { \\\n"
+          "            memo_t* m_ = memo_slot(parser->memo, parser->memo_mask, (r), pos); \\\n"
+          "            if(m_->generation == parser->generation && m_->rule == (r) && m_->pos == pos) { \\\n"
+          "                if(m_->end == 0xffffffffu) \\\n                    goto F##site; \\\n"
+          "                call_pos = pos; \\\n                pos = m_->end; \\\n"
+          "                goto R##site; \\\n            } \\\n        } \\\n    } while(0)\n\n",
+          fp);
+
+    fputs("#define GUARD_DEPENDS(r) \\\n    do { \\\n"
+          "        uint32_t i_ = num_frames - 1; \\\n"
+          "        while(parser->frames[i_].rule != (r) || parser->frames[i_].pos != pos) \\\n"
+          "            i_--; \\\n"
+          "        if(i_ < parser->frames[num_frames - 1].depends) \\\n"
+          "            parser->frames[num_frames - 1].depends = i_; \\\n    } while(0)\n\n",
+          fp);
+
+    fputs("#define FINISH_FRAME(end) \\\n    do { \\\n"
+          "        if(f->depends >= num_frames) { \\\n"
+          "            if(parser->memo != NULL) \\\n"
+          "                *memo_slot(parser->memo, parser->memo_mask, f->rule, f->pos) \\\n"
+          "                        = (memo_t){ parser->generation, f->rule, f->pos, (end) }; \\\n"
+          "        } \\\n"
+          "        else if(f->depends < parser->frames[num_frames - 1].depends) \\\n"
+          "            parser->frames[num_frames - 1].depends = f->depends; \\\n    } while(0)\n\n",
+          fp);
+}
+
+static void emit_parse(FILE* fp, heap_image_t* img, const char* prefix) {
+
+    uint32_t start = img->header.start_rule - img->header.num_terminals - 1;
+
+    emit_string_fmt(fp, "long %s_parse(%s_parser_t* parser, const uint32_t* tokens, uint32_t num_tokens, void* data) {\n\n",
+                    prefix, prefix);
+    fputs("    frame_t* f;\n    uint32_t num_frames = 0;\n    uint32_t num_choices = 0;\n"
+          "    uint32_t pos = 0;\n    uint32_t farthest = 0;\n    uint32_t call_pos = 0;\n\n    (void)data;\n",
+          fp);
+    emit_tables(fp, img);
+
+    fputs("\n    memset(parser->active, 0, sizeof(parser->active));\n"
+          "    if(parser->memo != NULL && ++parser->generation == 0) {\n"
+          "        memset(parser->memo, 0, (parser->memo_mask + 1) * sizeof(memo_t));\n"
+          "        parser->generation = 1;\n    }\n",
+          fp);
+    emit_string_fmt(fp, "    CALL(0, %u); // the start rule has no calling state\n    ", start);
+    emit_goto(fp, img->symbols[img->header.start_rule].data);
+    fputs("\n\n", fp);
+
+    for(uint32_t n = PGEN_FIRST_STATE; n < img->header.num_states; n++)
+        emit_state(fp, img, n);
+
+    fputs("\nmatch:\n"
+          "    f = &parser->frames[--num_frames];\n"
+          "    parser->active[f->rule] = f->saved_active;\n"
+          "    num_choices = f->choice_base;\n"
+          "    if(num_frames == 0) {\n        parser->farthest = farthest;\n        return pos;\n    }\n"
+          "    FINISH_FRAME(pos);\n"
+          "    call_pos = f->pos;\n"
+          "    RESUME(resume_return, f->state);\n\n"
+          "fail:\n"
+          "    f = &parser->frames[num_frames - 1];\n"
+          "    if(num_choices > f->choice_base) {\n"
+          "        num_choices--;\n"
+          "        pos = parser->choices[num_choices].pos;\n"
+          "        RESUME(resume_state, parser->choices[num_choices].state);\n    }\n"
+          "    num_frames--;\n"
+          "    parser->active[f->rule] = f->saved_active;\n"
+          "    pos = f->pos;\n"
+          "    if(num_frames == 0) {\n        parser->farthest = farthest;\n        return -1;\n    }\n"
+          "    FINISH_FRAME(0xffffffffu);\n"
+          "    RESUME(resume_fail, f->state);\n\n",
+          fp);
+
+    emit_returns(fp, img);
+    fputs("\n", fp);
+    emit_dispatch(fp, img);
+
+    fputs("\nout_of_memory:\n    parser->farthest = farthest;\n    return -1;\n}\n", fp);
+}
+
+/*
+ * Write <name>.c and <name>.h. The prefix of the public names is the base
+ * name of the C file.
+ */
+int emit_code(heap_image_t* img, parser_state_t* pstate, const char* fname) {
+
+    const char* base = strrchr(fname, '/');
+    base = (base != NULL) ? base + 1 : fname;
+    const char* dot = strrchr(fname, '.');
+    int len = (dot != NULL && dot > base) ? (int)(dot - fname) : (int)strlen(fname);
+
+    string_t* hname = create_string_fmt("%.*s.h", len, fname);
+    // a C name can not start with a digit, and one that starts with an
+    // underscore is reserved
+    int lead = !isalpha((unsigned char)*base);
+    string_t* prefix = create_string_fmt("%s%.*s", lead ? "p" : "", (int)(fname + len - base), base);
+    for(char* p = prefix->buffer; *p != '\0'; p++)
+        *p = isalnum((unsigned char)*p) ? tolower((unsigned char)*p) : '_';
+
+    string_t* guard = create_string_fmt("_%s_H_", raw_string(prefix));
+    upcase(guard);
+
+    int errors = 0;
+    FILE* fp = fopen(raw_string(hname), "w");
+    if(fp == NULL) {
+        fprintf(stderr, "cannot open output file \"%s\": %s\n", raw_string(hname), strerror(errno));
+        errors++;
+    }
+    else {
+        emit_header(fp, img, raw_string(prefix), raw_string(guard));
+        fclose(fp);
+    }
+
+    fp = fopen(fname, "w");
+    if(fp == NULL) {
+        fprintf(stderr, "cannot open output file \"%s\": %s\n", fname, strerror(errno));
+        errors++;
+    }
+    else {
+        const char* hbase = strrchr(raw_string(hname), '/');
+        hbase = (hbase != NULL) ? hbase + 1 : raw_string(hname);
+
+        emit_string_fmt(fp, "/*\n * Generated by pgen. Do not edit.\n */\n");
+        emit_string_fmt(fp, "#include <stdint.h>\n#include <stdlib.h>\n#include <string.h>\n\n#include \"%s\"\n\n", hbase);
+        if(len_string(pstate->precode) > 0)
+            emit_string_fmt(fp, "%s\n\n", raw_string(pstate->precode));
+
+        emit_support(fp, img, raw_string(prefix));
+        emit_parse(fp, img, raw_string(prefix));
+
+        if(len_string(pstate->postcode) > 0)
+            emit_string_fmt(fp, "\n%s\n", raw_string(pstate->postcode));
+
+        if(ferror(fp)) {
+            fprintf(stderr, "cannot write output file \"%s\"\n", fname);
+            errors++;
+        }
+        fclose(fp);
+    }
+
+    destroy_string(guard);
+    destroy_string(prefix);
+    destroy_string(hname);
+
+    return errors;
+}
@@ -0,0 +1,349 @@
+/*
+ * Write the minimized DFA as the compressed tables that are described in
+ * pgen_comb.h.
+ *
+ * The terminal transitions of a state are first matched against the
+ * states just before it. When all of the transitions of one of those are
+ * also transitions of this state, it becomes the default state and only
+ * the rest are stored. What is left of each state is then placed in the
+ * entry array, fullest states first, at the lowest base where none of
+ * its entries are taken.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "alloc.h"
+#include "errors.h"
+#include "emit.h"
+#include "cmdline.h"
+#include "pgen_comb.h"
+
+// how many states before this one are tried as its default
+#define DEFAULT_WINDOW 64
+
+typedef struct {
+    uint32_t symbol;
+    uint32_t next;
+    uint32_t rank;
+} comb_trans_t;
+
+typedef struct {
+    pgen_comb_header_t header;
+    pgen_symbol_t* symbols;
+    pgen_comb_state_t* states;
+    pgen_comb_entry_t* entries;
+    int cap_entries;
+    pgen_comb_call_t* calls;
+    comb_trans_t* terms; // terminal transitions of every state
+    int* term_start;     // first terminal transition of each state, plus one
+    int* residual;       // transitions not found in the default state
+} comb_image_t;
+
+static int num_terms(comb_image_t* img, int state) {
+
+    return img->term_start[state + 1] - img->term_start[state];
+}
+
+static void split_transitions(comb_image_t* img, heap_image_t* heap, dfa_t* dfa) {
+
+    uint32_t num_terminals = heap->header.num_terminals;
+
+    img->states = _ALLOC_ARRAY(pgen_comb_state_t, dfa->num_states);
+    img->calls = _ALLOC_ARRAY(pgen_comb_call_t, dfa->num_trans + 1);
+    img->terms = _ALLOC_ARRAY(comb_trans_t, dfa->num_trans + 1);
+    img->term_start = _ALLOC_ARRAY(int, dfa->num_states + 1);
+
+    int nterms = 0;
+    int ncalls = 0;
+
+    for(int d = 0; d < dfa->num_states; d++) {
+        dfa_state_t* st = &dfa->states[d];
+        pgen_comb_state_t* out = &img->states[d];
+
+        out->fallback = PGEN_COMB_NONE;
+        out->calls = ncalls;
+        out->accept = st->accept;
+        img->term_start[d] = nterms;
+
+        for(int k = 0; k < st->num_trans; k++) {
+            dfa_trans_t* tr = &dfa->trans[st->trans + k];
+            uint32_t sym = heap->sym_map[tr->symbol];
+
+            if(sym > 0 && sym <= num_terminals) {
+                img->terms[nterms].symbol = sym;
+                img->terms[nterms].next = tr->target;
+                img->terms[nterms].rank = out->num_calls;
+                nterms++;
+            }
+            else if(sym == 0)
+                FATAL("internal error: the DFA has an empty transition");
+            else {
+                img->calls[ncalls].symbol = sym;
+                img->calls[ncalls].next = tr->target;
+                img->calls[ncalls].first = heap->states[heap->state_map[d] + k].first;
+                ncalls++;
+                out->num_calls++;
+            }
+        }
+    }
+
+    img->term_start[dfa->num_states] = nterms;
+    img->header.num_calls = ncalls;
+}
+
+static void choose_defaults(comb_image_t* img, int num_states, int num_terminals) {
+
+    int* stamp = _ALLOC_ARRAY(int, num_terminals + 1);
+    int* shared = _ALLOC_ARRAY(int, num_terminals + 1);
+    comb_trans_t** row = _ALLOC_ARRAY(comb_trans_t*, num_terminals + 1);
+
+    for(int i = 0; i <= num_terminals; i++)
+        stamp[i] = shared[i] = -1;
+
+    img->residual = _ALLOC_ARRAY(int, num_states);
+
+    for(int d = 0; d < num_states; d++) {
+        int count = num_terms(img, d);
+        img->residual[d] = count;
+        if(count == 0)
+            continue;
+
+        for(int i = img->term_start[d]; i < img->term_start[d + 1]; i++) {
+            stamp[img->terms[i].symbol] = d;
+            row[img->terms[i].symbol] = &img->terms[i];
+        }
+
+        int best = -1;
+        int best_count = 0;
+        for(int t = (d > DEFAULT_WINDOW) ? d - DEFAULT_WINDOW : 0; t < d; t++) {
+            int tcount = num_terms(img, t);
+            if(img->states[t].fallback != PGEN_COMB_NONE || tcount <= best_count || tcount > count)
+                continue;
+
+            int i;
+            for(i = img->term_start[t]; i < img->term_start[t + 1]; i++) {
+                comb_trans_t* tr = &img->terms[i];
+                if(stamp[tr->symbol] != d || row[tr->symbol]->next != tr->next || row[tr->symbol]->rank != tr->rank)
+                    break;
+            }
+
+            if(i == img->term_start[t + 1]) {
+                best = t;
+                best_count = tcount;
+            }
+        }
+
+        if(best >= 0) {
+            img->states[d].fallback = best;
+            img->residual[d] = count - best_count;
+            for(int i = img->term_start[best]; i < img->term_start[best + 1]; i++)
+                shared[img->terms[i].symbol] = d;
+
+            // the shared transitions are moved to the end of the row
+            int keep = img->term_start[d];
+            for(int i = img->term_start[d]; i < img->term_start[d + 1]; i++) {
+                if(shared[img->terms[i].symbol] != d) {
+                    comb_trans_t tmp = img->terms[keep];
+                    img->terms[keep++] = img->terms[i];
+                    img->terms[i] = tmp;
+                }
+            }
+        }
+    }
+
+    _FREE(row);
+    _FREE(shared);
+    _FREE(stamp);
+}
+
+// qsort() has no context argument, so each state carries its own key
+typedef struct {
+    int residual;
+    int state;
+} order_t;
+
+static int by_residual(const void* a, const void* b) {
+
+    const order_t* oa = a;
+    const order_t* ob = b;
+    int diff = ob->residual - oa->residual;
+
+    return (diff != 0) ? diff : oa->state - ob->state;
+}
+
+static void reserve_entries(comb_image_t* img, int size) {
+
+    if(size > img->cap_entries) {
+        int old = img->cap_entries;
+        while(size > img->cap_entries)
+            img->cap_entries <<= 1;
+        img->entries = _REALLOC_ARRAY(img->entries, pgen_comb_entry_t, img->cap_entries);
+        memset(&img->entries[old], 0, (img->cap_entries - old) * sizeof(pgen_comb_entry_t));
+        for(int i = old; i < img->cap_entries; i++)
+            img->entries[i].check = PGEN_COMB_NONE;
+    }
+}
+
+static void place_states(comb_image_t* img, int num_states, int num_terminals) {
+
+    order_t* order = _ALLOC_ARRAY(order_t, num_states);
+    for(int d = 0; d < num_states; d++)
+        order[d] = (order_t){ img->residual[d], d };
+
+    qsort(order, num_states, sizeof(order_t), by_residual);
+
+    img->cap_entries = 1 << 8;
+    img->entries = _ALLOC_ARRAY(pgen_comb_entry_t, img->cap_entries);
+    for(int i = 0; i < img->cap_entries; i++)
+        img->entries[i].check = PGEN_COMB_NONE;
+
+    int first_free = 0;
+    int max_base = 0;
+
+    for(int n = 0; n < num_states; n++) {
+        int d = order[n].state;
+        int count = img->residual[d];
+        comb_trans_t* row = &img->terms[img->term_start[d]];
+
+        if(count == 0) {
+            img->states[d].base = 0;
+            continue;
+        }
+
+        int base = first_free - (int)row[0].symbol;
+        for(int k = 1; k < count; k++)
+            if(first_free - (int)row[k].symbol < base)
+                base = first_free - (int)row[k].symbol;
+        if(base < 0)
+            base = 0;
+
+        for(;; base++) {
+            reserve_entries(img, base + num_terminals + 1);
+            int k;
+            for(k = 0; k < count; k++)
+                if(img->entries[base + row[k].symbol].check != PGEN_COMB_NONE)
+                    break;
+            if(k == count)
+                break;
+        }
+
+        for(int k = 0; k < count; k++) {
+            pgen_comb_entry_t* e = &img->entries[base + row[k].symbol];
+            e->check = d;
+            e->next = row[k].next;
+            e->rank = row[k].rank;
+        }
+
+        img->states[d].base = base;
+        if(base > max_base)
+            max_base = base;
+        while(first_free < img->cap_entries && img->entries[first_free].check != PGEN_COMB_NONE)
+            first_free++;
+    }
+
+    // pad so that base + terminal never runs off of the end
+    img->header.num_entries = max_base + num_terminals + 1;
+    reserve_entries(img, img->header.num_entries);
+
+    _FREE(order);
+}
+
+static comb_image_t* create_comb_image(heap_image_t* heap, dfa_t* dfa) {
+
+    comb_image_t* img = _ALLOC_TYPE(comb_image_t);
+
+    img->header.magic = PGEN_COMB_MAGIC;
+    img->header.version = PGEN_COMB_VERSION;
+    img->header.num_terminals = heap->header.num_terminals;
+    img->header.num_rules = heap->header.num_rules;
+    img->header.num_actions = heap->header.num_actions;
+    img->header.num_symbols = heap->header.num_symbols;
+    img->header.num_states = dfa->num_states;
+    img->header.start_rule = heap->header.start_rule;
+    img->header.string_size = heap->header.string_size;
+    img->header.num_first = heap->header.num_first;
+    img->header.first_words = heap->header.first_words;
+
+    // the same symbols as the heap, but a rule enters a DFA state
+    img->symbols = _ALLOC_ARRAY(pgen_symbol_t, heap->header.num_symbols);
+    memcpy(img->symbols, heap->symbols, heap->header.num_symbols * sizeof(pgen_symbol_t));
+    for(int r = 0; r < dfa->num_rules; r++)
+        img->symbols[1 + heap->header.num_terminals + r].data
+                = (dfa->rule_start[r] >= 0) ? (uint32_t)dfa->rule_start[r] : PGEN_COMB_NONE;
+
+    split_transitions(img, heap, dfa);
+    choose_defaults(img, dfa->num_states, heap->header.num_terminals);
+    place_states(img, dfa->num_states, heap->header.num_terminals);
+
+    img->header.symbol_table = sizeof(pgen_comb_header_t);
+    img->header.state_table = img->header.symbol_table + img->header.num_symbols * sizeof(pgen_symbol_t);
+    img->header.entry_table = img->header.state_table + img->header.num_states * sizeof(pgen_comb_state_t);
+    img->header.call_table = img->header.entry_table + img->header.num_entries * sizeof(pgen_comb_entry_t);
+    img->header.first_table = img->header.call_table + img->header.num_calls * sizeof(pgen_comb_call_t);
+    img->header.string_table
+            = img->header.first_table + img->header.num_first * img->header.first_words * sizeof(uint32_t);
+    img->header.size = img->header.string_table + ((img->header.string_size + 3) & ~3u);
+
+    return img;
+}
+
+static void destroy_comb_image(comb_image_t* img) {
+
+    _FREE(img->symbols);
+    _FREE(img->states);
+    _FREE(img->entries);
+    _FREE(img->calls);
+    _FREE(img->terms);
+    _FREE(img->term_start);
+    _FREE(img->residual);
+    _FREE(img);
+}
+
+/*
+ * Compress the DFA and write it to a file. The heap image supplies the
+ * symbols and the strings.
+ */
+int emit_comb(heap_image_t* heap, dfa_t* dfa, const char* fname) {
+
+    comb_image_t* img = create_comb_image(heap, dfa);
+    int num_terms = img->term_start[dfa->num_states];
+
+    if(in_cmd_list("dump", "comb"))
+        fprintf(stderr, "comb: %d terminal transitions in %u entries, %u bytes of tables (dense would be %lu)\n",
+                num_terms, img->header.num_entries, img->header.num_entries * (uint32_t)sizeof(pgen_comb_entry_t),
+                (unsigned long)dfa->num_states * (heap->header.num_terminals + 1) * sizeof(uint32_t));
+
+    FILE* fp = fopen(fname, "wb");
+    if(fp == NULL) {
+        fprintf(stderr, "cannot open output file \"%s\": %s\n", fname, strerror(errno));
+        destroy_comb_image(img);
+        return 1;
+    }
+
+    pgen_comb_header_t* h = &img->header;
+    uint32_t pad = 0;
+    size_t pad_len = (h->size - h->string_table) - h->string_size;
+    int ok = fwrite(h, sizeof(pgen_comb_header_t), 1, fp) == 1
+            && fwrite(img->symbols, sizeof(pgen_symbol_t), h->num_symbols, fp) == h->num_symbols
+            && fwrite(img->states, sizeof(pgen_comb_state_t), h->num_states, fp) == h->num_states
+            && fwrite(img->entries, sizeof(pgen_comb_entry_t), h->num_entries, fp) == h->num_entries
+            && fwrite(img->calls, sizeof(pgen_comb_call_t), h->num_calls, fp) == h->num_calls
+            && fwrite(heap->first_sets, sizeof(uint32_t), h->num_first * h->first_words, fp)
+                    == h->num_first * h->first_words
+            && fwrite(heap->strings, 1, h->string_size, fp) == h->string_size
+            && fwrite(&pad, 1, pad_len, fp) == pad_len;
+
+    if(fclose(fp) != 0)
+        ok = 0;
+
+    destroy_comb_image(img);
+
+    if(!ok) {
+        fprintf(stderr, "cannot write output file \"%s\": %s\n", fname, strerror(errno));
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,380 @@
+/*
+ * Lay the minimized DFA out as the state heap that is described in
+ * pgen_heap.h and write it to a file.
+ *
+ * A DFA state with several transitions becomes a chain of heap states,
+ * one for each transition, in the order that the grammar gives them. The
+ * no_match_state of the last one in the chain is the "match" state if
+ * the rule can finish there, otherwise it is the "no match" state.
+ *
+ * A run of at least MIN_DISPATCH terminal tests in a chain gets a
+ * dispatch on its first state. The dispatch is a dense table when the
+ * terminals are close together and a sorted array when they are not.
+ *
+ * A state that tests a non-terminal or a code block gets the FIRST set
+ * of its transition, unless the transition can match nothing. Equal sets
+ * are stored once.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "alloc.h"
+#include "errors.h"
+#include "emit.h"
+#include "bitset.h"
+#include "hash_map.h"
+
+#define MIN_DISPATCH 4
+
+// a dense table may have this many slots for each terminal in it
+#define DENSE_FACTOR 3
+
+static uint32_t add_heap_string(heap_image_t* img, const char* str) {
+
+    uint32_t offset = img->header.string_size;
+    uint32_t len = strlen(str) + 1;
+
+    if(offset + len > img->cap_strings) {
+        while(offset + len > img->cap_strings)
+            img->cap_strings <<= 1;
+        img->strings = _REALLOC_ARRAY(img->strings, char, img->cap_strings);
+    }
+
+    memcpy(&img->strings[offset], str, len);
+    img->header.string_size += len;
+
+    return offset;
+}
+
+static void number_symbols(heap_image_t* img, dfa_t* dfa) {
+
+    int num_symbols = len_ptr_list(dfa->symbols);
+    int num_terminals = 0;
+    int num_actions = 0;
+    symbol_t* sym;
+
+    for(int i = 1; i < num_symbols; i++) {
+        sym = index_ptr_list(dfa->symbols, i);
+        if(sym->tok->type == CODE_BLOCK)
+            num_actions++;
+        else if(sym->tok->type != NON_TERMINAL)
+            num_terminals++;
+    }
+
+    img->header.num_terminals = num_terminals;
+    img->header.num_rules = dfa->num_rules;
+    img->header.num_actions = num_actions;
+    img->header.num_symbols = 1 + num_terminals + dfa->num_rules + num_actions;
+    img->symbols = _ALLOC_ARRAY(pgen_symbol_t, img->header.num_symbols);
+    img->sym_map = _ALLOC_ARRAY(int, num_symbols);
+
+    // symbol zero is already all zeros, which is PGEN_SYM_ALWAYS
+    int next_term = 1;
+    int next_action = 1 + num_terminals + dfa->num_rules;
+
+    for(int i = 1; i < num_symbols; i++) {
+        sym = index_ptr_list(dfa->symbols, i);
+        pgen_symbol_t* out;
+
+        switch(sym->tok->type) {
+            case NON_TERMINAL:
+                img->sym_map[i] = 1 + num_terminals + sym->rule;
+                out = &img->symbols[img->sym_map[i]];
+                out->type = PGEN_SYM_NON_TERMINAL;
+                out->name = add_heap_string(img, raw_string(sym->tok->str));
+                out->text = out->name;
+                break;
+
+            case CODE_BLOCK:
+                img->sym_map[i] = next_action++;
+                out = &img->symbols[img->sym_map[i]];
+                out->type = PGEN_SYM_ACTION;
+                out->text = add_heap_string(img, raw_string(sym->tok->str));
+                break;
+
+            default:
+                img->sym_map[i] = next_term++;
+                out = &img->symbols[img->sym_map[i]];
+                out->type = PGEN_SYM_TERMINAL;
+                out->name = add_heap_string(img, raw_string(sym->tok->ptype));
+                out->text = add_heap_string(img, raw_string(sym->tok->str));
+                break;
+        }
+    }
+}
+
+static int is_terminal(heap_image_t* img, int state) {
+
+    uint32_t sym = img->states[state].terminal;
+    return sym > 0 && sym <= img->header.num_terminals;
+}
+
+static uint32_t add_dispatch_word(heap_image_t* img, uint32_t word) {
+
+    uint32_t index = img->header.num_dispatch_words;
+
+    if(index >= (uint32_t)img->cap_dispatch_words) {
+        img->cap_dispatch_words = (img->cap_dispatch_words == 0) ? 1 << 8 : img->cap_dispatch_words << 1;
+        img->dispatch_words = _REALLOC_ARRAY(img->dispatch_words, uint32_t, img->cap_dispatch_words);
+    }
+
+    img->dispatch_words[index] = word;
+    img->header.num_dispatch_words++;
+
+    return index;
+}
+
+static int by_terminal(const void* a, const void* b) {
+
+    const pgen_state_t* sa = a;
+    const pgen_state_t* sb = b;
+
+    return (sa->terminal > sb->terminal) - (sa->terminal < sb->terminal);
+}
+
+static void add_dispatch(heap_image_t* img, int first, int last) {
+
+    int count = last - first + 1;
+    uint32_t miss = img->states[last].no_match_state;
+    pgen_state_t* sorted = _ALLOC_ARRAY(pgen_state_t, count);
+
+    memcpy(sorted, &img->states[first], count * sizeof(pgen_state_t));
+    qsort(sorted, count, sizeof(pgen_state_t), by_terminal);
+
+    pgen_dispatch_t* d = &img->dispatch[img->header.num_dispatch];
+    uint32_t low = sorted[0].terminal;
+    uint32_t span = sorted[count - 1].terminal - low + 1;
+
+    d->miss = miss;
+    d->words = img->header.num_dispatch_words;
+
+    if(span <= (uint32_t)count * DENSE_FACTOR) {
+        d->type = PGEN_DISPATCH_DENSE;
+        d->low = low;
+        d->count = span;
+        for(uint32_t i = 0; i < span; i++)
+            add_dispatch_word(img, 0);
+        for(int i = 0; i < count; i++)
+            img->dispatch_words[d->words + sorted[i].terminal - low] = sorted[i].state_number;
+    }
+    else {
+        d->type = PGEN_DISPATCH_SORTED;
+        d->count = count;
+        for(int i = 0; i < count; i++)
+            add_dispatch_word(img, sorted[i].terminal);
+        for(int i = 0; i < count; i++)
+            add_dispatch_word(img, sorted[i].state_number);
+    }
+
+    // once one of the run has matched, none of the others can
+    for(int i = first; i <= last; i++)
+        img->states[i].no_match_state = miss;
+
+    img->header.num_dispatch++;
+    img->states[first].dispatch = img->header.num_dispatch;
+
+    _FREE(sorted);
+}
+
+static void make_dispatch(heap_image_t* img) {
+
+    img->dispatch = _ALLOC_ARRAY(pgen_dispatch_t, img->header.num_states / MIN_DISPATCH + 1);
+
+    int first = PGEN_FIRST_STATE;
+    while(first < (int)img->header.num_states) {
+        int last = first;
+        if(is_terminal(img, first)) {
+            while(img->states[last].no_match_state == (uint32_t)last + 1 && is_terminal(img, last + 1))
+                last++;
+            if(last - first + 1 >= MIN_DISPATCH)
+                add_dispatch(img, first, last);
+        }
+        first = last + 1;
+    }
+}
+
+typedef struct {
+    hash_map_t* map; // FIRST set -> its number
+    int cap;         // sets that img->first_sets has room for
+} first_index_t;
+
+static uint32_t add_first_set(heap_image_t* img, first_index_t* index, const uint32_t* set) {
+
+    int words = img->header.first_words;
+    int added;
+    uint32_t* num = insert_hash_map(index->map, set, &added);
+
+    if(added) {
+        if((int)img->header.num_first + 1 > index->cap) {
+            index->cap = (index->cap == 0) ? 1 << 5 : index->cap << 1;
+            img->first_sets = _REALLOC_ARRAY(img->first_sets, uint32_t, index->cap * words);
+        }
+        memcpy(&img->first_sets[img->header.num_first * words], set, words * sizeof(uint32_t));
+        *num = ++img->header.num_first;
+    }
+
+    return *num;
+}
+
+static void make_first(heap_image_t* img, dfa_t* dfa, first_sets_t* sets) {
+
+    uint64_t* bits = _ALLOC_ARRAY(uint64_t, sets->words);
+    uint32_t* set = _ALLOC_ARRAY(uint32_t, img->header.first_words);
+    int num_symbols = len_ptr_list(dfa->symbols);
+    first_index_t index;
+    index.map = create_hash_map(img->header.first_words * sizeof(uint32_t), sizeof(uint32_t), NULL, NULL);
+    index.cap = 0;
+
+    for(int d = 0; d < dfa->num_states; d++) {
+        dfa_state_t* st = &dfa->states[d];
+        for(int k = 0; k < st->num_trans; k++) {
+            dfa_trans_t* tr = &dfa->trans[st->trans + k];
+            uint32_t sym = img->sym_map[tr->symbol];
+            if(sym <= img->header.num_terminals)
+                continue;
+
+            bits_clear(bits, sets->words);
+            if(trans_first(sets, dfa, tr, bits))
+                continue;
+
+            memset(set, 0, img->header.first_words * sizeof(uint32_t));
+            for(int b = bits_next(bits, sets->words, 1); b >= 0 && b < num_symbols; b = bits_next(bits, sets->words, b + 1)) {
+                uint32_t term = img->sym_map[b];
+                set[term >> 5] |= 1u << (term & 31);
+            }
+
+            img->states[img->state_map[d] + k].first = add_first_set(img, &index, set);
+        }
+    }
+
+    destroy_hash_map(index.map);
+    _FREE(set);
+    _FREE(bits);
+}
+
+heap_image_t* create_heap_image(dfa_t* dfa, first_sets_t* sets) {
+
+    heap_image_t* img = _ALLOC_TYPE(heap_image_t);
+
+    img->header.magic = PGEN_HEAP_MAGIC;
+    img->header.version = PGEN_HEAP_VERSION;
+    img->cap_strings = 1 << 8;
+    img->strings = _ALLOC_ARRAY(char, img->cap_strings);
+    add_heap_string(img, ""); // offset zero is the empty string
+
+    number_symbols(img, dfa);
+
+    // find where every DFA state starts in the heap
+    img->state_map = _ALLOC_ARRAY(int, dfa->num_states + 1);
+    int next = PGEN_FIRST_STATE;
+    for(int d = 0; d < dfa->num_states; d++) {
+        dfa_state_t* st = &dfa->states[d];
+        if(st->num_trans == 0)
+            img->state_map[d] = st->accept ? PGEN_STATE_MATCH : PGEN_STATE_NO_MATCH;
+        else {
+            img->state_map[d] = next;
+            next += st->num_trans;
+        }
+    }
+
+    img->header.num_states = next;
+    img->states = _ALLOC_ARRAY(pgen_state_t, next);
+    for(int i = 0; i < PGEN_FIRST_STATE; i++)
+        img->states[i].state_number = i;
+
+    for(int d = 0; d < dfa->num_states; d++) {
+        dfa_state_t* st = &dfa->states[d];
+        for(int k = 0; k < st->num_trans; k++) {
+            dfa_trans_t* tr = &dfa->trans[st->trans + k];
+            int idx = img->state_map[d] + k;
+            pgen_state_t* out = &img->states[idx];
+
+            out->state_number = idx;
+            out->terminal = img->sym_map[tr->symbol];
+            out->match_state = img->state_map[tr->target];
+            if(k + 1 < st->num_trans)
+                out->no_match_state = idx + 1;
+            else
+                out->no_match_state = st->accept ? PGEN_STATE_MATCH : PGEN_STATE_NO_MATCH;
+            out->error_state = 0;
+        }
+    }
+
+    // the entry state of a non-terminal is its data
+    for(int r = 0; r < dfa->num_rules; r++) {
+        int start = dfa->rule_start[r];
+        img->symbols[1 + img->header.num_terminals + r].data
+                = (start >= 0) ? img->state_map[start] : PGEN_STATE_NO_MATCH;
+    }
+
+    img->header.start_rule = 1 + img->header.num_terminals;
+
+    make_dispatch(img);
+
+    img->header.first_words = (img->header.num_terminals + 32) / 32;
+    make_first(img, dfa, sets);
+
+    img->header.symbol_table = sizeof(pgen_heap_header_t);
+    img->header.state_table = img->header.symbol_table + img->header.num_symbols * sizeof(pgen_symbol_t);
+    img->header.dispatch_table = img->header.state_table + img->header.num_states * sizeof(pgen_state_t);
+    img->header.dispatch_words = img->header.dispatch_table + img->header.num_dispatch * sizeof(pgen_dispatch_t);
+    img->header.first_table = img->header.dispatch_words + img->header.num_dispatch_words * sizeof(uint32_t);
+    img->header.string_table
+            = img->header.first_table + img->header.num_first * img->header.first_words * sizeof(uint32_t);
+    img->header.size = img->header.string_table + ((img->header.string_size + 3) & ~3u);
+
+    return img;
+}
+
+void destroy_heap_image(heap_image_t* img) {
+
+    if(img != NULL) {
+        _FREE(img->symbols);
+        _FREE(img->states);
+        _FREE(img->strings);
+        _FREE(img->sym_map);
+        _FREE(img->state_map);
+        _FREE(img->dispatch);
+        _FREE(img->dispatch_words);
+        _FREE(img->first_sets);
+        _FREE(img);
+    }
+}
+
+/*
+ * Write the heap to a file. The string table is padded so that the size
+ * of the file is a whole number of words.
+ */
+int emit_heap(heap_image_t* img, const char* fname) {
+
+    FILE* fp = fopen(fname, "wb");
+    if(fp == NULL) {
+        fprintf(stderr, "cannot open output file \"%s\": %s\n", fname, strerror(errno));
+        return 1;
+    }
+
+    uint32_t pad = 0;
+    size_t pad_len = (img->header.size - img->header.string_table) - img->header.string_size;
+    int ok = fwrite(&img->header, sizeof(pgen_heap_header_t), 1, fp) == 1
+            && fwrite(img->symbols, sizeof(pgen_symbol_t), img->header.num_symbols, fp) == img->header.num_symbols
+            && fwrite(img->states, sizeof(pgen_state_t), img->header.num_states, fp) == img->header.num_states
+            && fwrite(img->dispatch, sizeof(pgen_dispatch_t), img->header.num_dispatch, fp) == img->header.num_dispatch
+            && fwrite(img->dispatch_words, sizeof(uint32_t), img->header.num_dispatch_words, fp)
+                    == img->header.num_dispatch_words
+            && fwrite(img->first_sets, sizeof(uint32_t), img->header.num_first * img->header.first_words, fp)
+                    == img->header.num_first * img->header.first_words
+            && fwrite(img->strings, 1, img->header.string_size, fp) == img->header.string_size
+            && fwrite(&pad, 1, pad_len, fp) == pad_len;
+
+    if(fclose(fp) != 0)
+        ok = 0;
+
+    if(!ok) {
+        fprintf(stderr, "cannot write output file \"%s\": %s\n", fname, strerror(errno));
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,187 @@
+/*
+ * Nullable, FIRST and FOLLOW sets of the rules, worked out on the
+ * minimized DFAs.
+ *
+ * A set has one bit for every symbol in the symbol list, and only the
+ * bits of terminals are ever set, except that bit zero in a FOLLOW set
+ * stands for the end of the input. A code block matches nothing, so it
+ * does not change the sets. Left recursion is not taken into account,
+ * which only makes the sets larger than they need to be, never smaller.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "alloc.h"
+#include "errors.h"
+#include "states.h"
+#include "bitset.h"
+
+static int is_terminal(dfa_t* dfa, int index) {
+
+    symbol_t* sym = index_ptr_list(dfa->symbols, index);
+    return sym != NULL && sym->tok->type != NON_TERMINAL && sym->tok->type != CODE_BLOCK;
+}
+
+/*
+ * The FIRST set of one transition followed by the rest of its rule is
+ * or'ed into set. Returns non-zero if the transition can match nothing.
+ */
+int trans_first(first_sets_t* sets, dfa_t* dfa, dfa_trans_t* tr, uint64_t* set) {
+
+    symbol_t* sym = index_ptr_list(dfa->symbols, tr->symbol);
+    int words = sets->words;
+
+    if(sym == NULL)
+        FATAL("internal error: the DFA has an empty transition");
+
+    if(is_terminal(dfa, tr->symbol)) {
+        bits_set(set, tr->symbol);
+        return 0;
+    }
+
+    if(sym->tok->type == NON_TERMINAL) {
+        bits_or(set, &sets->first[sym->rule * words], words);
+        if(!sets->nullable[sym->rule])
+            return 0;
+    }
+
+    bits_or(set, &sets->state_first[tr->target * words], words);
+    return sets->state_nullable[tr->target];
+}
+
+static int update_states(first_sets_t* sets, dfa_t* dfa, uint64_t* scratch) {
+
+    int words = sets->words;
+    int changed = 0;
+
+    // the rules are mostly built front to back, so go the other way
+    for(int d = dfa->num_states - 1; d >= 0; d--) {
+        dfa_state_t* st = &dfa->states[d];
+        int nullable = st->accept;
+
+        bits_clear(scratch, words);
+        for(int k = 0; k < st->num_trans; k++)
+            if(trans_first(sets, dfa, &dfa->trans[st->trans + k], scratch))
+                nullable = 1;
+
+        if(bits_or(&sets->state_first[d * words], scratch, words))
+            changed = 1;
+        if(nullable && !sets->state_nullable[d]) {
+            sets->state_nullable[d] = 1;
+            changed = 1;
+        }
+    }
+
+    for(int r = 0; r < dfa->num_rules; r++) {
+        int start = dfa->rule_start[r];
+        if(start < 0)
+            continue;
+
+        if(bits_or(&sets->first[r * words], &sets->state_first[start * words], words))
+            changed = 1;
+        if(sets->state_nullable[start] && !sets->nullable[r]) {
+            sets->nullable[r] = 1;
+            changed = 1;
+        }
+    }
+
+    return changed;
+}
+
+static int update_follow(first_sets_t* sets, dfa_t* dfa) {
+
+    int words = sets->words;
+    int changed = 0;
+
+    for(int d = 0; d < dfa->num_states; d++) {
+        dfa_state_t* st = &dfa->states[d];
+
+        for(int k = 0; k < st->num_trans; k++) {
+            dfa_trans_t* tr = &dfa->trans[st->trans + k];
+            symbol_t* sym = index_ptr_list(dfa->symbols, tr->symbol);
+            if(sym == NULL || sym->tok->type != NON_TERMINAL)
+                continue;
+
+            uint64_t* follow = &sets->follow[sym->rule * words];
+            if(bits_or(follow, &sets->state_first[tr->target * words], words))
+                changed = 1;
+            if(sets->state_nullable[tr->target] && bits_or(follow, &sets->follow[st->rule * words], words))
+                changed = 1;
+        }
+    }
+
+    return changed;
+}
+
+first_sets_t* make_first_sets(dfa_t* dfa) {
+
+    first_sets_t* sets = _ALLOC_TYPE(first_sets_t);
+    int num_symbols = len_ptr_list(dfa->symbols);
+
+    sets->words = BITS_WORDS(num_symbols);
+    sets->num_rules = dfa->num_rules;
+    sets->num_states = dfa->num_states;
+    sets->nullable = _ALLOC_ARRAY(char, dfa->num_rules);
+    sets->first = _ALLOC_ARRAY(uint64_t, dfa->num_rules * sets->words);
+    sets->follow = _ALLOC_ARRAY(uint64_t, dfa->num_rules * sets->words);
+    sets->state_nullable = _ALLOC_ARRAY(char, dfa->num_states);
+    sets->state_first = _ALLOC_ARRAY(uint64_t, dfa->num_states * sets->words);
+
+    uint64_t* scratch = _ALLOC_ARRAY(uint64_t, sets->words);
+    while(update_states(sets, dfa, scratch))
+        ;
+    _FREE(scratch);
+
+    // the start rule can be followed by the end of the input
+    if(dfa->num_rules > 0)
+        bits_set(sets->follow, 0);
+
+    while(update_follow(sets, dfa))
+        ;
+
+    return sets;
+}
+
+void destroy_first_sets(first_sets_t* sets) {
+
+    if(sets != NULL) {
+        _FREE(sets->nullable);
+        _FREE(sets->first);
+        _FREE(sets->follow);
+        _FREE(sets->state_nullable);
+        _FREE(sets->state_first);
+        _FREE(sets);
+    }
+}
+
+static void dump_set(dfa_t* dfa, uint64_t* set, int words) {
+
+    for(int bit = bits_next(set, words, 0); bit >= 0; bit = bits_next(set, words, bit + 1))
+        fprintf(stderr, " %s", (bit == 0) ? "(end)" : symbol_name(dfa->symbols, bit));
+    fprintf(stderr, "\n");
+}
+
+void dump_first_sets(first_sets_t* sets, dfa_t* dfa) {
+
+    int num_symbols = len_ptr_list(dfa->symbols);
+    const char** names = _ALLOC_ARRAY(const char*, dfa->num_rules);
+
+    for(int i = 1; i < num_symbols; i++) {
+        symbol_t* sym = index_ptr_list(dfa->symbols, i);
+        if(sym->tok->type == NON_TERMINAL && sym->rule >= 0)
+            names[sym->rule] = raw_string(sym->tok->str);
+    }
+
+    for(int r = 0; r < dfa->num_rules; r++) {
+        // the sets of a left recursive rule can be larger than they need to be
+        int left = dfa->recursion != NULL && dfa->recursion->kind[r] == RECURSION_LEFT;
+        fprintf(stderr, "first: %s%s%s\n    FIRST:", names[r], sets->nullable[r] ? " (nullable)" : "",
+                left ? " (left recursive)" : "");
+        dump_set(dfa, &sets->first[r * sets->words], sets->words);
+        fprintf(stderr, "    FOLLOW:");
+        dump_set(dfa, &sets->follow[r * sets->words], sets->words);
+    }
+
+    _FREE(names);
+}
@@ -0,0 +1,436 @@
+/*
+ * DFA minimization by partition refinement.
+ *
+ * This is Hopcroft's algorithm in the form given by Valmari and Lehtinen,
+ * "Efficient minimization of DFAs with partial transition functions",
+ * 2008. It runs in O(m log n) for m transitions and n states and works
+ * directly on partial DFAs, which is what nfa2dfa() produces. There is no
+ * need to add a dead state and fill in the missing transitions.
+ *
+ * Two partitions are refined together. The blocks partition the states
+ * and the cords partition the transitions. Splitting a block by a cord
+ * marks the tail states of the transitions in the cord. Splitting a cord
+ * by a block marks the transitions that end in the block.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "alloc.h"
+#include "states.h"
+
+typedef struct {
+    int count;   // number of sets
+    int* elems;  // elements, grouped by set
+    int* loc;    // location of each element in elems
+    int* set_of; // set of each element
+    int* first;  // first location of each set
+    int* past;   // one past the last location of each set
+} partition_t;
+
+typedef struct {
+    partition_t blocks;
+    partition_t cords;
+    int* marked;  // number of marked elements in each set
+    int* touched; // sets with marked elements
+    int num_touched;
+    int* tail;
+    int* label;
+    int* head;
+    int num_trans;
+    int* adj;     // transitions grouped by tail or head
+    int* adj_off; // offsets into adj, one per state plus one
+    int num_reached;
+} refine_t;
+
+static void init_partition(partition_t* p, int n) {
+
+    p->count = (n > 0) ? 1 : 0;
+    p->elems = _ALLOC_ARRAY(int, n + 1);
+    p->loc = _ALLOC_ARRAY(int, n + 1);
+    p->set_of = _ALLOC_ARRAY(int, n + 1);
+    p->first = _ALLOC_ARRAY(int, n + 1);
+    p->past = _ALLOC_ARRAY(int, n + 1);
+
+    for(int i = 0; i < n; i++) {
+        p->elems[i] = p->loc[i] = i;
+        p->set_of[i] = 0;
+    }
+
+    if(n > 0) {
+        p->first[0] = 0;
+        p->past[0] = n;
+    }
+}
+
+static void free_partition(partition_t* p) {
+
+    _FREE(p->elems);
+    _FREE(p->loc);
+    _FREE(p->set_of);
+    _FREE(p->first);
+    _FREE(p->past);
+}
+
+// move the element to the marked part at the front of its set
+static void mark(refine_t* rf, partition_t* p, int e) {
+
+    int s = p->set_of[e];
+    int i = p->loc[e];
+    int j = p->first[s] + rf->marked[s];
+
+    p->elems[i] = p->elems[j];
+    p->loc[p->elems[i]] = i;
+    p->elems[j] = e;
+    p->loc[e] = j;
+
+    if(rf->marked[s]++ == 0)
+        rf->touched[rf->num_touched++] = s;
+}
+
+// split every touched set into its marked and unmarked parts
+static void split(refine_t* rf, partition_t* p) {
+
+    while(rf->num_touched > 0) {
+        int s = rf->touched[--rf->num_touched];
+        int j = p->first[s] + rf->marked[s];
+
+        if(j == p->past[s]) {
+            rf->marked[s] = 0;
+            continue;
+        }
+
+        // the smaller part becomes the new set
+        int z = p->count;
+        if(rf->marked[s] <= p->past[s] - j) {
+            p->first[z] = p->first[s];
+            p->past[z] = p->first[s] = j;
+        }
+        else {
+            p->past[z] = p->past[s];
+            p->first[z] = p->past[s] = j;
+        }
+
+        for(int i = p->first[z]; i < p->past[z]; i++)
+            p->set_of[p->elems[i]] = z;
+
+        rf->marked[s] = rf->marked[z] = 0;
+        p->count++;
+    }
+}
+
+static void make_adjacent(refine_t* rf, int num_states, int* key) {
+
+    for(int q = 0; q <= num_states; q++)
+        rf->adj_off[q] = 0;
+    for(int t = 0; t < rf->num_trans; t++)
+        rf->adj_off[key[t]]++;
+    for(int q = 0; q < num_states; q++)
+        rf->adj_off[q + 1] += rf->adj_off[q];
+    for(int t = rf->num_trans; t--;)
+        rf->adj[--rf->adj_off[key[t]]] = t;
+}
+
+// move a state to the reached part at the front of block zero
+static void reach(refine_t* rf, int q) {
+
+    partition_t* b = &rf->blocks;
+    int i = b->loc[q];
+
+    if(i >= rf->num_reached) {
+        b->elems[i] = b->elems[rf->num_reached];
+        b->loc[b->elems[i]] = i;
+        b->elems[rf->num_reached] = q;
+        b->loc[q] = rf->num_reached++;
+    }
+}
+
+// keep the states reachable through from -> to, and their transitions
+static void remove_unreachable(refine_t* rf, int num_states, int* from, int* to) {
+
+    partition_t* b = &rf->blocks;
+
+    make_adjacent(rf, num_states, from);
+    for(int i = 0; i < rf->num_reached; i++) {
+        int q = b->elems[i];
+        for(int j = rf->adj_off[q]; j < rf->adj_off[q + 1]; j++)
+            reach(rf, to[rf->adj[j]]);
+    }
+
+    int j = 0;
+    for(int t = 0; t < rf->num_trans; t++) {
+        if(b->loc[from[t]] < rf->num_reached) {
+            rf->head[j] = rf->head[t];
+            rf->label[j] = rf->label[t];
+            rf->tail[j] = rf->tail[t];
+            j++;
+        }
+    }
+
+    rf->num_trans = j;
+    b->past[0] = rf->num_reached;
+    rf->num_reached = 0;
+}
+
+// group the transitions into one cord per symbol with a counting sort
+static void make_cords(refine_t* rf, int num_symbols) {
+
+    partition_t* c = &rf->cords;
+    int* count = _ALLOC_ARRAY(int, num_symbols + 1);
+
+    for(int t = 0; t < rf->num_trans; t++)
+        count[rf->label[t] + 1]++;
+    for(int a = 0; a < num_symbols; a++)
+        count[a + 1] += count[a];
+
+    c->count = 0;
+    for(int a = 0; a < num_symbols; a++) {
+        if(count[a + 1] > count[a]) {
+            c->first[c->count] = count[a];
+            c->past[c->count] = count[a + 1];
+            rf->marked[c->count] = 0;
+            c->count++;
+        }
+    }
+
+    for(int t = 0; t < rf->num_trans; t++) {
+        int i = count[rf->label[t]]++;
+        c->elems[i] = t;
+        c->loc[t] = i;
+    }
+
+    for(int s = 0; s < c->count; s++)
+        for(int i = c->first[s]; i < c->past[s]; i++)
+            c->set_of[c->elems[i]] = s;
+
+    _FREE(count);
+}
+
+/*
+ * Split the blocks so that two states stay together only if they belong
+ * to the same rule and have the same symbols on their transitions, in the
+ * same order. The parser tries the transitions in that order and commits
+ * to the first one that matches, so the order is part of what a state
+ * accepts. This counts the transitions out by their position in the state
+ * and then by symbol, and splits the blocks once for each group.
+ */
+static void split_by_order(refine_t* rf, dfa_t* dfa, unsigned char* useful, int num_symbols) {
+
+    int n = dfa->num_states;
+    int m = rf->num_trans;
+    partition_t* b = &rf->blocks;
+
+    // the rule of every useful state
+    int* count = _ALLOC_ARRAY(int, dfa->num_rules + 1);
+    int* order = _ALLOC_ARRAY(int, ((n > m) ? n : m) + 1);
+    for(int q = 0; q < n; q++)
+        if(useful[q])
+            count[dfa->states[q].rule + 1]++;
+    for(int r = 0; r < dfa->num_rules; r++)
+        count[r + 1] += count[r];
+    for(int q = 0; q < n; q++)
+        if(useful[q])
+            order[count[dfa->states[q].rule]++] = q;
+
+    for(int i = 0; i < count[dfa->num_rules];) {
+        int r = dfa->states[order[i]].rule;
+        for(; i < count[dfa->num_rules] && dfa->states[order[i]].rule == r; i++)
+            mark(rf, b, order[i]);
+        split(rf, b);
+    }
+    _FREE(count);
+
+    // the position of every transition in its state, they are in order
+    int* pos = _ALLOC_ARRAY(int, m + 1);
+    int max_pos = 0;
+    for(int t = 0; t < m; t++) {
+        pos[t] = (t > 0 && rf->tail[t - 1] == rf->tail[t]) ? pos[t - 1] + 1 : 0;
+        if(pos[t] > max_pos)
+            max_pos = pos[t];
+    }
+
+    // by symbol, then stably by position
+    int* by_label = _ALLOC_ARRAY(int, m + 1);
+    count = _ALLOC_ARRAY(int, ((num_symbols > max_pos) ? num_symbols : max_pos + 1) + 1);
+    for(int t = 0; t < m; t++)
+        count[rf->label[t] + 1]++;
+    for(int a = 0; a < num_symbols; a++)
+        count[a + 1] += count[a];
+    for(int t = 0; t < m; t++)
+        by_label[count[rf->label[t]]++] = t;
+
+    memset(count, 0, (max_pos + 2) * sizeof(int));
+    for(int t = 0; t < m; t++)
+        count[pos[t] + 1]++;
+    for(int k = 0; k <= max_pos; k++)
+        count[k + 1] += count[k];
+    for(int i = 0; i < m; i++)
+        order[count[pos[by_label[i]]]++] = by_label[i];
+
+    for(int i = 0; i < m;) {
+        int k = pos[order[i]];
+        int a = rf->label[order[i]];
+        for(; i < m && pos[order[i]] == k && rf->label[order[i]] == a; i++)
+            mark(rf, b, rf->tail[order[i]]);
+        split(rf, b);
+    }
+
+    _FREE(by_label);
+    _FREE(count);
+    _FREE(pos);
+    _FREE(order);
+}
+
+/*
+ * Return a new DFA with the equivalent states merged. States that can
+ * not be reached from a rule start, or that can not reach an accepting
+ * state, are dropped. Only states of the same rule with the same symbols
+ * in the same order can be merged, so the transitions of a merged state
+ * are taken from any member and are still in the order of the grammar.
+ */
+dfa_t* minimize_dfa(dfa_t* dfa) {
+
+    refine_t rf;
+    int n = dfa->num_states;
+    int m = dfa->num_trans;
+    int num_symbols = len_ptr_list(dfa->symbols);
+
+    rf.num_trans = 0;
+    rf.num_reached = 0;
+    rf.num_touched = 0;
+    rf.tail = _ALLOC_ARRAY(int, m + 1);
+    rf.label = _ALLOC_ARRAY(int, m + 1);
+    rf.head = _ALLOC_ARRAY(int, m + 1);
+    rf.adj = _ALLOC_ARRAY(int, m + 1);
+    rf.adj_off = _ALLOC_ARRAY(int, n + 1);
+    rf.marked = _ALLOC_ARRAY(int, ((n > m) ? n : m) + 1);
+    rf.touched = _ALLOC_ARRAY(int, ((n > m) ? n : m) + 1);
+
+    for(int q = 0; q < n; q++) {
+        dfa_state_t* st = &dfa->states[q];
+        for(int t = st->trans; t < st->trans + st->num_trans; t++) {
+            rf.tail[rf.num_trans] = q;
+            rf.label[rf.num_trans] = dfa->trans[t].symbol;
+            rf.head[rf.num_trans] = dfa->trans[t].target;
+            rf.num_trans++;
+        }
+    }
+
+    init_partition(&rf.blocks, n);
+
+    // forward from the start of every rule
+    for(int r = 0; r < dfa->num_rules; r++)
+        if(dfa->rule_start[r] >= 0)
+            reach(&rf, dfa->rule_start[r]);
+    remove_unreachable(&rf, n, rf.tail, rf.head);
+
+    // backward from the accepting states
+    int num_final = 0;
+    for(int q = 0; q < n; q++)
+        if(dfa->states[q].accept && rf.blocks.loc[q] < rf.blocks.past[0])
+            reach(&rf, q);
+    num_final = rf.num_reached;
+    remove_unreachable(&rf, n, rf.head, rf.tail);
+
+    int num_useful = (n > 0) ? rf.blocks.past[0] : 0;
+    unsigned char* useful = _ALLOC_ARRAY(unsigned char, n + 1);
+    for(int q = 0; q < n; q++)
+        useful[q] = rf.blocks.loc[q] < num_useful;
+
+    // the accepting states were reached first, so they are the marked part
+    if(num_useful > 0) {
+        rf.marked[0] = num_final;
+        if(num_final > 0) {
+            rf.touched[rf.num_touched++] = 0;
+            split(&rf, &rf.blocks);
+        }
+    }
+
+    if(num_useful > 0)
+        split_by_order(&rf, dfa, useful, num_symbols);
+
+    init_partition(&rf.cords, rf.num_trans);
+    if(rf.num_trans > 0)
+        make_cords(&rf, num_symbols);
+
+    make_adjacent(&rf, n, rf.head);
+
+    int b = 1;
+    for(int c = 0; c < rf.cords.count; c++) {
+        for(int i = rf.cords.first[c]; i < rf.cords.past[c]; i++)
+            mark(&rf, &rf.blocks, rf.tail[rf.cords.elems[i]]);
+        split(&rf, &rf.blocks);
+
+        for(; b < rf.blocks.count; b++) {
+            for(int i = rf.blocks.first[b]; i < rf.blocks.past[b]; i++) {
+                int q = rf.blocks.elems[i];
+                for(int j = rf.adj_off[q]; j < rf.adj_off[q + 1]; j++)
+                    mark(&rf, &rf.cords, rf.adj[j]);
+            }
+            split(&rf, &rf.cords);
+        }
+    }
+
+    // number the blocks in the order of their lowest old state
+    int* new_id = _ALLOC_ARRAY(int, rf.blocks.count + 1);
+    for(int i = 0; i < rf.blocks.count; i++)
+        new_id[i] = -1;
+
+    dfa_t* min = _ALLOC_TYPE(dfa_t);
+    min->cap_states = (rf.blocks.count > 0) ? rf.blocks.count : 1;
+    min->states = _ALLOC_ARRAY(dfa_state_t, min->cap_states);
+    min->cap_trans = (rf.num_trans > 0) ? rf.num_trans : 1;
+    min->trans = _ALLOC_ARRAY(dfa_trans_t, min->cap_trans);
+    min->num_rules = dfa->num_rules;
+    min->rule_start = _ALLOC_ARRAY(int, dfa->num_rules);
+    min->symbols = dfa->symbols;
+    min->recursion = dfa->recursion;
+
+    int* rep = _ALLOC_ARRAY(int, rf.blocks.count + 1);
+    for(int q = 0; q < n; q++) {
+        if(useful[q]) {
+            int blk = rf.blocks.set_of[q];
+            if(new_id[blk] < 0) {
+                new_id[blk] = min->num_states++;
+                rep[new_id[blk]] = q;
+            }
+        }
+    }
+
+    for(int s = 0; s < min->num_states; s++) {
+        dfa_state_t* old = &dfa->states[rep[s]];
+        dfa_state_t* st = &min->states[s];
+        st->rule = old->rule;
+        st->accept = old->accept;
+        st->trans = min->num_trans;
+        for(int t = old->trans; t < old->trans + old->num_trans; t++) {
+            int target = dfa->trans[t].target;
+            if(useful[target]) {
+                min->trans[min->num_trans].symbol = dfa->trans[t].symbol;
+                min->trans[min->num_trans].target = new_id[rf.blocks.set_of[target]];
+                min->num_trans++;
+            }
+        }
+        st->num_trans = min->num_trans - st->trans;
+    }
+
+    for(int r = 0; r < dfa->num_rules; r++) {
+        int q = dfa->rule_start[r];
+        min->rule_start[r] = (q >= 0 && useful[q]) ? new_id[rf.blocks.set_of[q]] : -1;
+    }
+
+    _FREE(rep);
+    _FREE(new_id);
+    _FREE(useful);
+    free_partition(&rf.cords);
+    free_partition(&rf.blocks);
+    _FREE(rf.tail);
+    _FREE(rf.label);
+    _FREE(rf.head);
+    _FREE(rf.adj);
+    _FREE(rf.adj_off);
+    _FREE(rf.marked);
+    _FREE(rf.touched);
+
+    return min;
+}
@@ -1,14 +1,15 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <errno.h>
 
 #include "alloc.h"
 #include "tokens.h"
 #include "parser.h"
-#include "array.h"
-
-static int errors = 0;
-static parser_state_t* parser_state;
+#include "vector.h"
+#include "symtab.h"
+#include "context.h"
 
 #define DUMP(r) \
     do { \
@@ -20,31 +21,48 @@ static parser_state_t* parser_state;
         fprintf(stderr, "\n"); \
     } while(0)
 
+// tracking parentheses depth
+typedef struct {
+    int num_alts;  // number of alternates that have been seen
+    int num_atoms; // number of atomic operands (not operators)
+} parens_t;
+
+DECLARE_VECTOR(parens, parens_t)
+
+/*
+ * The postfix form of a rule is built in the scratch list of the context,
+ * which is reused for every rule, and then copied into the grammar arena.
+ * The copy is never changed, so it is not destroyed.
+ */
+static pointer_list_t* keep_expr(compile_t* ctx, pointer_list_t* out) {
+
+    pointer_list_t* lst = _ARENA_TYPE(ctx->grammar_arena, pointer_list_t);
+    lst->len = lst->cap = len_ptr_list(out);
+    lst->buffer = _ARENA_ARRAY(ctx->grammar_arena, void*, lst->cap);
+    memcpy(lst->buffer, out->buffer, lst->len * sizeof(void*));
+
+    return lst;
+}
+
 // shunting yard to convert infix expression token stream to postfix.
 // see https://swtch.com/~rsc/regexp/regexp1.html
-static pointer_list_t* expression(void) {
+static pointer_list_t* expression(compile_t* ctx) {
 
     int finished = 0;
     token_t* tok;
-    pointer_list_t* out = create_ptr_list();
-    pointer_list_t* stack = create_ptr_list();
-
-    // tracking parentheses depth
-    struct parns_t {
-        int num_alts;  // number of alternates that have been seen
-        int num_atoms; // number of atomic operands (not operators)
-    } parn, *p_parn;
-
-    array_t* parn_stack = create_array(sizeof(struct parns_t), NULL);
+    pointer_list_t* out = ctx->postfix;
+    clear_ptr_list(out);
+    parens_t parn;
+    vec_parens_t parn_stack = VECTOR_INIT;
     int num_alts = 0;
     int num_atoms = 0;
 
     while(! finished) {
-        tok = get_token();
+        tok = get_token(ctx);
 
         if(tok == NULL) {
             fprintf(stderr, "syntax error: unexpected end of input\n");
-            errors++;
+            ctx->errors++;
             return NULL; // no match
         }
 
@@ -58,12 +76,12 @@ static pointer_list_t* expression(void) {
             case PROVIDES:
             case REQUIRES:
                 fprintf(stderr, "syntax error: %d: unexpected directive \"%s\"\n", tok->line_no, tok->str->buffer);
-                errors++;
+                ctx->errors++;
                 return NULL; // no match
 
             case COLON:
                 fprintf(stderr, "syntax error: %d: unexpected \":\" encountered\n", tok->line_no);
-                errors++;
+                ctx->errors++;
                 return NULL;
 
             case PLUS:
@@ -71,71 +89,70 @@ static pointer_list_t* expression(void) {
             case QUESTION:
                 if(num_atoms == 0) {
                     fprintf(stderr, "syntax error: %d: unexpected '%s' encountered\n", tok->line_no, tok->str->buffer);
-                    errors++;
+                    ctx->errors++;
                     return NULL;
                 }
 
-                append_ptr_list(out, copy_token(tok));
-                consume_token(); // consume the operator
+                append_ptr_list(out, copy_token(ctx, tok));
+                consume_token(ctx); // consume the operator
                 break;
 
             case PIPE:
                 if(num_atoms == 0) {
                     fprintf(stderr, "syntax error: %d: unexpected '|' encountered\n", tok->line_no);
-                    errors++;
+                    ctx->errors++;
                     return NULL;
                 }
 
                 while(--num_atoms > 0) {
-                    append_ptr_list(out, create_token(".", CATENATE));
+                    append_ptr_list(out, create_expr_token(ctx, ".", CATENATE));
                 }
 
                 num_alts++;
 
-                consume_token(); // consume the '|'
+                consume_token(ctx); // consume the '|'
                 break;
 
             case OPAREN:
                 if(num_atoms > 1) {
                     num_atoms--;
-                    append_ptr_list(out, create_token(".", CATENATE));
+                    append_ptr_list(out, create_expr_token(ctx, ".", CATENATE));
                 }
 
                 parn.num_alts = num_alts;
                 parn.num_atoms = num_atoms;
-                push_array(parn_stack, &parn);
+                vec_parens_push(&parn_stack, parn);
                 num_alts = num_atoms = 0;
-                parn.num_atoms = 0;
 
-                consume_token(); // consume the '(' token
+                consume_token(ctx); // consume the '(' token
                 break;
 
             case CPAREN:
-                if(NULL == peek_array(parn_stack)) {
+                if(vec_parens_len(&parn_stack) == 0) {
                     fprintf(stderr, "syntax error: %d: unexpected ')' encountered (eps)\n", tok->line_no);
-                    errors++;
+                    ctx->errors++;
                     return NULL;
                 }
 
                 if(num_atoms == 0) {
                     fprintf(stderr, "syntax error: %d: unexpected ')' encountered (n0)\n", tok->line_no);
-                    errors++;
+                    ctx->errors++;
                     return NULL;
                 }
 
                 while(--num_atoms > 0) {
-                    append_ptr_list(out, create_token(".", CATENATE));
+                    append_ptr_list(out, create_expr_token(ctx, ".", CATENATE));
                 }
 
                 for(; num_alts > 0; num_alts--) {
-                    append_ptr_list(out, create_token("|", PIPE));
+                    append_ptr_list(out, create_expr_token(ctx, "|", PIPE));
                 }
 
-                p_parn = pop_array(parn_stack);
-                num_alts = p_parn->num_alts;
-                num_atoms = p_parn->num_atoms + 1;
+                parn = vec_parens_pop(&parn_stack);
+                num_alts = parn.num_alts;
+                num_atoms = parn.num_atoms + 1;
 
-                consume_token();     // consume the ')'
+                consume_token(ctx);     // consume the ')'
                 break;
 
             case CODE_BLOCK:
@@ -145,47 +162,46 @@ static pointer_list_t* expression(void) {
             case TERMINAL_OPER:
                 if(num_atoms > 1) {
                     --num_atoms;
-                    append_ptr_list(out, create_token(".", CATENATE));
+                    append_ptr_list(out, create_expr_token(ctx, ".", CATENATE));
                 }
 
-                append_ptr_list(out, copy_token(tok));
+                append_ptr_list(out, copy_token(ctx, tok));
                 num_atoms++;
 
-                consume_token(); // consume the operand
+                consume_token(ctx); // consume the operand
                 break;
 
             case SEMICOLON:
 {
-                if(NULL != peek_array(parn_stack)) {
+                if(vec_parens_len(&parn_stack) != 0) {
                     fprintf(stderr, "syntax error: %d: imbalanced parentheses\n", tok->line_no);
-                    errors++;
+                    ctx->errors++;
                     return NULL;
                 }
 
                 while(--num_atoms > 0) {
-                    append_ptr_list(out, create_token(".", CATENATE));
+                    append_ptr_list(out, create_expr_token(ctx, ".", CATENATE));
                 }
 
                 for(; num_alts > 0; num_alts--) {
-                    append_ptr_list(out, create_token("|", PIPE));
+                    append_ptr_list(out, create_expr_token(ctx, "|", PIPE));
                 }
 
-                destroy_array(parn_stack);
-                destroy_ptr_list(stack);
+                vec_parens_destroy(&parn_stack);
                 finished++; }
                 // do not consume the semicolon
                 break;
 
             default:
-                fprintf(stderr, "internal error: unknown token type in expression(): %d", tok->type);
+                fprintf(stderr, "internal error: unknown token type in expression(): %d\n", tok->type);
                 exit(1);
         }
     }
 
-    return out;
+    return keep_expr(ctx, out);
 }
 
-static int rule(void) {
+static int rule(compile_t* ctx) {
 
     int finished = 0;
     int state = 0;
@@ -197,13 +213,13 @@ static int rule(void) {
     pointer_list_t* expr = NULL;
 
     while(! finished) {
-        tok = get_token();
+        tok = get_token(ctx);
         switch(state) {
             case 0:
                 // non-terminal or no match
                 if(tok->type == NON_TERMINAL) {
-                    name = copy_token(tok);
-                    consume_token();
+                    name = copy_token(ctx, tok);
+                    consume_token(ctx);
                     state = 1;
                 }
                 else
@@ -213,19 +229,19 @@ static int rule(void) {
             case 1:
                 // COLON or error
                 if(tok->type == COLON) {
-                    consume_token();
+                    consume_token(ctx);
                     state = 2;
                 }
                 else {
                     fprintf(stderr, "syntax error: %d: expected a \":\" but got a \"%s\"\n", tok->line_no, tok->str->buffer);
-                    errors++;
+                    ctx->errors++;
                     state = 102;
                 }
                 break;
 
             case 2:
                 // expression or error
-                if(NULL != (expr = expression()))
+                if(NULL != (expr = expression(ctx)))
                     state = 3;
                 else
                     state = 102;
@@ -234,12 +250,12 @@ static int rule(void) {
             case 3:
                 // SEMICOLON or error
                 if(tok->type == SEMICOLON) {
-                    consume_token();
+                    consume_token(ctx);
                     state = 100;
                 }
                 else {
                     fprintf(stderr, "syntax error: %d: expected a \";\" but got a \"%s\"\n", tok->line_no, tok->str->buffer);
-                    errors++;
+                    ctx->errors++;
                     state = 102;
                 }
                 break;
@@ -247,13 +263,13 @@ static int rule(void) {
             case 100:
                 // match
                 rule = create_rule(name);
-                parser_state->crnt_rule = rule;
-                parser_state->crnt_rule->expr = expr;
+                ctx->pstate->crnt_rule = rule;
+                ctx->pstate->crnt_rule->expr = expr;
 
-                if(parser_state->start_rule == NULL)
-                    parser_state->start_rule = rule;
+                if(ctx->pstate->start_rule == NULL)
+                    ctx->pstate->start_rule = rule;
 
-                append_ptr_list(parser_state->rule_list, rule);
+                append_ptr_list(ctx->pstate->rule_list, rule);
 
                 DUMP(rule);
                 result++;
@@ -275,120 +291,122 @@ static int rule(void) {
     return result;
 }
 
-static int directive(void) {
+static int directive(compile_t* ctx) {
 
     int finished = 0;
     int state = 0;
     int result = 0; // no match
     token_t* tok;
+    int line_no;
 
     while(! finished) {
-        tok = get_token();
+        tok = get_token(ctx);
         switch(state) {
             case 0:
+                line_no = tok->line_no; // the token is gone once it is consumed
                 // directive or no match
                 switch(tok->type) {
                     case PRETEXT: {
-                        token_t* cb = consume_token();
+                        token_t* cb = consume_token(ctx);
                         if(cb->type == CODE_BLOCK) {
-                            parser_state->pretext = copy_string(cb->str);
+                            ctx->pstate->pretext = copy_string(cb->str);
                             state = 100;
                         }
                         else {
-                            fprintf(stderr, "syntax error: %d: expected code block after \"%%pretext\" directive\n", tok->line_no);
+                            fprintf(stderr, "syntax error: %d: expected code block after \"%%pretext\" directive\n", line_no);
                             fprintf(stderr, "\tbut got %s\n", tok_to_str(cb->type));
-                            errors++;
+                            ctx->errors++;
                             state = 102;
                         }
                     } break;
                     case POSTTEXT: {
-                        token_t* cb = consume_token();
+                        token_t* cb = consume_token(ctx);
                         if(cb->type == CODE_BLOCK) {
-                            parser_state->posttext = copy_string(cb->str);
+                            ctx->pstate->posttext = copy_string(cb->str);
                             state = 100;
                         }
                         else {
-                            fprintf(stderr, "syntax error: %d: expected code block after \"%%posttext\" directive\n", tok->line_no);
+                            fprintf(stderr, "syntax error: %d: expected code block after \"%%posttext\" directive\n", line_no);
                             fprintf(stderr, "\tbut got %s\n", tok_to_str(cb->type));
-                            errors++;
+                            ctx->errors++;
                             state = 102;
                         }
                     } break;
                     case PRECODE: {
-                        token_t* cb = consume_token();
+                        token_t* cb = consume_token(ctx);
                         if(cb->type == CODE_BLOCK) {
-                            parser_state->precode = copy_string(cb->str);
+                            ctx->pstate->precode = copy_string(cb->str);
                             state = 100;
                         }
                         else {
-                            fprintf(stderr, "syntax error: %d: expected code block after \"%%precode\" directive\n", tok->line_no);
+                            fprintf(stderr, "syntax error: %d: expected code block after \"%%precode\" directive\n", line_no);
                             fprintf(stderr, "\tbut got %s\n", tok_to_str(cb->type));
-                            errors++;
+                            ctx->errors++;
                             state = 102;
                         }
                     } break;
                     case POSTCODE: {
-                        token_t* cb = consume_token();
+                        token_t* cb = consume_token(ctx);
                         if(cb->type == CODE_BLOCK) {
-                            parser_state->postcode = copy_string(cb->str);
+                            ctx->pstate->postcode = copy_string(cb->str);
                             state = 100;
                         }
                         else {
-                            fprintf(stderr, "syntax error: %d: expected code block after \"%%postcode\" directive\n", tok->line_no);
+                            fprintf(stderr, "syntax error: %d: expected code block after \"%%postcode\" directive\n", line_no);
                             fprintf(stderr, "\tbut got %s\n", tok_to_str(cb->type));
-                            errors++;
+                            ctx->errors++;
                             state = 102;
                         }
                     } break;
                     case TERM_DEF: {
-                        token_t* cb = consume_token();
+                        token_t* cb = consume_token(ctx);
                         if(cb->type == CODE_BLOCK) {
-                            parser_state->term_def = copy_string(cb->str);
+                            ctx->pstate->term_def = copy_string(cb->str);
                             state = 100;
                         }
                         else {
-                            fprintf(stderr, "syntax error: %d: expected code block after \"%%term_def\" directive\n", tok->line_no);
+                            fprintf(stderr, "syntax error: %d: expected code block after \"%%term_def\" directive\n", line_no);
                             fprintf(stderr, "\tbut got %s\n", tok_to_str(cb->type));
-                            errors++;
+                            ctx->errors++;
                             state = 102;
                         }
                     } break;
                     case NTERM_DEF: {
-                        token_t* cb = consume_token();
+                        token_t* cb = consume_token(ctx);
                         if(cb->type == CODE_BLOCK) {
-                            parser_state->nterm_def = copy_string(cb->str);
+                            ctx->pstate->nterm_def = copy_string(cb->str);
                             state = 100;
                         }
                         else {
-                            fprintf(stderr, "syntax error: %d: expected code block after \"%%nterm_def\" directive\n", tok->line_no);
+                            fprintf(stderr, "syntax error: %d: expected code block after \"%%nterm_def\" directive\n", line_no);
                             fprintf(stderr, "\tbut got %s\n", tok_to_str(cb->type));
-                            errors++;
+                            ctx->errors++;
                             state = 102;
                         }
                     } break;
                     case PROVIDES: {
-                        token_t* cb = consume_token();
+                        token_t* cb = consume_token(ctx);
                         if(cb->type == CODE_BLOCK) {
-                            parser_state->provides = copy_string(cb->str);
+                            ctx->pstate->provides = copy_string(cb->str);
                             state = 100;
                         }
                         else {
-                            fprintf(stderr, "syntax error: %d: expected code block after \"%%provides\" directive\n", tok->line_no);
+                            fprintf(stderr, "syntax error: %d: expected code block after \"%%provides\" directive\n", line_no);
                             fprintf(stderr, "\tbut got %s\n", tok_to_str(cb->type));
-                            errors++;
+                            ctx->errors++;
                             state = 102;
                         }
                     } break;
                     case REQUIRES: {
-                        token_t* cb = consume_token();
+                        token_t* cb = consume_token(ctx);
                         if(cb->type == CODE_BLOCK) {
-                            parser_state->requires = copy_string(cb->str);
+                            ctx->pstate->requires = copy_string(cb->str);
                             state = 100;
                         }
                         else {
-                            fprintf(stderr, "syntax error: %d: expected code block after \"%%requires\" directive\n", tok->line_no);
+                            fprintf(stderr, "syntax error: %d: expected code block after \"%%requires\" directive\n", line_no);
                             fprintf(stderr, "\tbut got %s\n", tok_to_str(cb->type));
-                            errors++;
+                            ctx->errors++;
                             state = 102;
                         }
                     } break;
@@ -419,51 +437,103 @@ static int directive(void) {
     return result;
 }
 
-int parser(void) {
+int parser(compile_t* ctx) {
 
     int finished = 0;
     int state = 0;
     token_t* tok;
 
     while(! finished) {
-        tok = get_token();
+        tok = get_token(ctx);
 
         // end of file
         if(tok == NULL)
             finished++;
-        else if(errors != 0)
+        else if(ctx->errors != 0)
             finished++;
         // rule or directive
-        else if(rule())
+        else if(rule(ctx))
             ; // found a rule
-        else if(directive())
+        else if(directive(ctx))
             ; // found a directive
         else {
             fprintf(stderr, "syntax error: %d: expected a rule, a directive, or end of the file\n", tok->line_no);
             fprintf(stderr, "\tbut got %s\n", tok_to_str(tok->type));
-            errors++;
+            ctx->errors++;
         }
     }
 
-    return errors;
+    return ctx->errors;
 }
 
-void init_parser(void) {
-
-    parser_state = _ALLOC_TYPE(parser_state_t);
-    parser_state->pretext = create_string(NULL);
-    parser_state->posttext = create_string(NULL);
-    parser_state->precode = create_string(NULL);
-    parser_state->postcode = create_string(NULL);
-    parser_state->term_def = create_string(NULL);
-    parser_state->nterm_def = create_string(NULL);
-    parser_state->provides = create_string(NULL);
-    parser_state->requires = create_string(NULL);
-    parser_state->rule_list = create_ptr_list();
-    parser_state->start_rule = NULL;
-
-    init_scanner();
-    consume_token();
+/*
+ * Start reading a grammar file. Returns NULL with errno set if the file
+ * can not be read.
+ */
+compile_t* init_parser(const char* fname) {
+
+    compile_t* ctx = _ALLOC_TYPE(compile_t);
+    ctx->fname = fname;
+    ctx->postfix = create_ptr_list();
+
+    parser_state_t* pstate = _ALLOC_TYPE(parser_state_t);
+    pstate->fname = fname;
+    pstate->pretext = create_string(NULL);
+    pstate->posttext = create_string(NULL);
+    pstate->precode = create_string(NULL);
+    pstate->postcode = create_string(NULL);
+    pstate->term_def = create_string(NULL);
+    pstate->nterm_def = create_string(NULL);
+    pstate->provides = create_string(NULL);
+    pstate->requires = create_string(NULL);
+    pstate->rule_list = create_ptr_list();
+    pstate->start_rule = NULL;
+    pstate->symtab = create_symtab();
+    ctx->pstate = pstate;
+
+    if(init_scanner(ctx, fname) != 0) {
+        int err = errno;
+        destroy_parser(ctx);
+        errno = err;
+        return NULL;
+    }
+
+    consume_token(ctx);
+    return ctx;
+}
+
+// free the grammar and everything that was made while reading it
+void destroy_parser(compile_t* ctx) {
+
+    rule_t* rule;
+    int mark = 0;
+
+    if(ctx != NULL) {
+        parser_state_t* pstate = ctx->pstate;
+
+        destroy_string(pstate->pretext);
+        destroy_string(pstate->posttext);
+        destroy_string(pstate->precode);
+        destroy_string(pstate->postcode);
+        destroy_string(pstate->term_def);
+        destroy_string(pstate->nterm_def);
+        destroy_string(pstate->provides);
+        destroy_string(pstate->requires);
+        while(NULL != (rule = iterate_ptr_list(pstate->rule_list, &mark)))
+            _FREE(rule);
+        destroy_ptr_list(pstate->rule_list);
+        destroy_symtab(pstate->symtab);
+        _FREE(pstate);
+
+        destroy_tokens(ctx);
+        destroy_ptr_list(ctx->postfix);
+        _FREE(ctx);
+    }
+}
+
+parser_state_t* get_parser_state(compile_t* ctx) {
+
+    return ctx->pstate;
 }
 
 rule_t* create_rule(token_t* name) {
@@ -4,6 +4,7 @@
 #include "string_buffer.h"
 #include "pointer_list.h"
 #include "tokens.h"
+#include "symtab.h"
 
 typedef struct {
     token_t* name;
@@ -11,6 +12,7 @@ typedef struct {
 } rule_t;
 
 typedef struct {
+    const char* fname; // the grammar file
     string_t* pretext;
     string_t* posttext;
     string_t* precode;
@@ -22,10 +24,13 @@ typedef struct {
     rule_t* start_rule;
     rule_t* crnt_rule;
     pointer_list_t* rule_list;
+    symtab_t* symtab; // names of the terminals and non-terminals
 } parser_state_t;
 
-void init_parser(void);
-int parser(void);
+compile_t* init_parser(const char* fname);
+void destroy_parser(compile_t* ctx);
+int parser(compile_t* ctx);
+parser_state_t* get_parser_state(compile_t* ctx);
 
 rule_t* create_rule(token_t* name);
 
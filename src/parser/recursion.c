@@ -0,0 +1,474 @@
+/*
+ * Find the recursive rules.
+ *
+ * Every reference to a non-terminal in the postfix expression of a rule
+ * is an edge of the rule graph. The strongly connected components of the
+ * graph are found with Tarjan's algorithm, and a rule is recursive when
+ * its component has a cycle.
+ *
+ * The rules that can match nothing are found with a work list over the
+ * nodes of all of the expressions. A node waits for as many of its
+ * operands as it needs, and each node and each rule is taken off the list
+ * at most once, whatever the recursion.
+ *
+ * A reference is a left edge when nothing has to be matched before it in
+ * the rule. A rule is left recursive when it has a cycle of left edges,
+ * which needs a second run of Tarjan's algorithm over the left edges
+ * only. Any other recursion consumes a token first, and it is called
+ * right recursion here. Both runs and the walks over the expressions are
+ * linear in the size of the grammar.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "alloc.h"
+#include "errors.h"
+#include "states.h"
+
+typedef struct {
+    int num_rules;
+    int* first; // first edge of each rule, plus an end mark
+    int* target;
+    char* left; // the edge is a left edge
+} graph_t;
+
+/*
+ * A postfix sub-expression while the expression is walked. The left
+ * edges in it form a list that is threaded through next, so that a
+ * catenation joins the lists without copying them.
+ */
+typedef struct {
+    int nullable;
+    int head; // first left edge, or -1
+    int tail;
+} term_t;
+
+static int rule_of(nfa_t* nfa, token_t* tok) {
+
+    symbol_t* sym = nfa->by_id[tok->id];
+
+    if(sym == NULL || sym->rule < 0)
+        FATAL("internal error: undefined non-terminal \"%s\" in the rule graph", raw_string(tok->str));
+
+    return sym->rule;
+}
+
+static void make_graph(graph_t* g, parser_state_t* pstate, nfa_t* nfa) {
+
+    rule_t* rule;
+    int mark = 0;
+    int num_edges = 0;
+
+    g->num_rules = len_ptr_list(pstate->rule_list);
+    g->first = _ALLOC_ARRAY(int, g->num_rules + 1);
+
+    for(int r = 0; NULL != (rule = iterate_ptr_list(pstate->rule_list, &mark)); r++) {
+        g->first[r] = num_edges;
+        for(int i = 0; i < len_ptr_list(rule->expr); i++)
+            if(((token_t*)index_ptr_list(rule->expr, i))->type == NON_TERMINAL)
+                num_edges++;
+    }
+    g->first[g->num_rules] = num_edges;
+
+    g->target = _ALLOC_ARRAY(int, num_edges + 1);
+    g->left = _ALLOC_ARRAY(char, num_edges + 1);
+
+    mark = 0;
+    for(int r = 0; NULL != (rule = iterate_ptr_list(pstate->rule_list, &mark)); r++) {
+        int e = g->first[r];
+        token_t* tok;
+        int tmark = 0;
+        while(NULL != (tok = iterate_ptr_list(rule->expr, &tmark)))
+            if(tok->type == NON_TERMINAL)
+                g->target[e++] = rule_of(nfa, tok);
+    }
+}
+
+/*
+ * Walk the postfix expression of one rule and mark its left edges, once
+ * the nullable rules are known. The stack and next are supplied by the
+ * caller.
+ */
+static void walk_rule(graph_t* g, rule_t* rule, int r, char* nullable, term_t* stack, int* next) {
+
+    int sp = 0;
+    int e = g->first[r];
+    term_t t1, t2;
+    token_t* tok;
+    int tmark = 0;
+
+    while(NULL != (tok = iterate_ptr_list(rule->expr, &tmark))) {
+        switch(tok->type) {
+            case CATENATE:
+                t2 = stack[--sp];
+                t1 = stack[--sp];
+                if(t1.nullable && t2.head >= 0) {
+                    if(t1.head >= 0)
+                        next[t1.tail] = t2.head;
+                    else
+                        t1.head = t2.head;
+                    t1.tail = t2.tail;
+                }
+                t1.nullable = t1.nullable && t2.nullable;
+                stack[sp++] = t1;
+                break;
+
+            case PIPE:
+                t2 = stack[--sp];
+                t1 = stack[--sp];
+                if(t2.head >= 0) {
+                    if(t1.head >= 0)
+                        next[t1.tail] = t2.head;
+                    else
+                        t1.head = t2.head;
+                    t1.tail = t2.tail;
+                }
+                t1.nullable = t1.nullable || t2.nullable;
+                stack[sp++] = t1;
+                break;
+
+            case QUESTION:
+            case STAR:
+                stack[sp - 1].nullable = 1;
+                break;
+
+            case PLUS:
+                break;
+
+            case NON_TERMINAL:
+                next[e] = -1;
+                stack[sp++] = (term_t){ nullable[g->target[e]], e, e };
+                e++;
+                break;
+
+            case CODE_BLOCK:
+                stack[sp++] = (term_t){ 1, -1, -1 };
+                break;
+
+            default:
+                stack[sp++] = (term_t){ 0, -1, -1 };
+                break;
+        }
+    }
+
+    if(sp > 0)
+        for(int l = stack[0].head; l >= 0; l = next[l])
+            g->left[l] = 1;
+}
+
+/*
+ * Tarjan's algorithm without recursion, since a chain of rules can be
+ * as long as the grammar. Fills in the component of each rule and returns
+ * the number of components. Components are numbered in the order that
+ * they are finished.
+ */
+static int find_components(graph_t* g, int left_only, int* component) {
+
+    int n = g->num_rules;
+    int* index = _ALLOC_ARRAY(int, n);
+    int* low = _ALLOC_ARRAY(int, n);
+    int* cursor = _ALLOC_ARRAY(int, n);
+    int* stack = _ALLOC_ARRAY(int, n);
+    int* calls = _ALLOC_ARRAY(int, n);
+    char* on_stack = _ALLOC_ARRAY(char, n);
+    int counter = 0;
+    int sp = 0;
+    int num_components = 0;
+
+    for(int v = 0; v < n; v++)
+        index[v] = -1;
+
+    for(int root = 0; root < n; root++) {
+        if(index[root] >= 0)
+            continue;
+
+        int depth = 0;
+        calls[depth++] = root;
+        index[root] = low[root] = counter++;
+        cursor[root] = g->first[root];
+        stack[sp++] = root;
+        on_stack[root] = 1;
+
+        while(depth > 0) {
+            int v = calls[depth - 1];
+
+            if(cursor[v] < g->first[v + 1]) {
+                int e = cursor[v]++;
+                if(left_only && !g->left[e])
+                    continue;
+
+                int w = g->target[e];
+                if(index[w] < 0) {
+                    calls[depth++] = w;
+                    index[w] = low[w] = counter++;
+                    cursor[w] = g->first[w];
+                    stack[sp++] = w;
+                    on_stack[w] = 1;
+                }
+                else if(on_stack[w] && index[w] < low[v])
+                    low[v] = index[w];
+                continue;
+            }
+
+            depth--;
+            if(low[v] == index[v]) {
+                int w;
+                do {
+                    w = stack[--sp];
+                    on_stack[w] = 0;
+                    component[w] = num_components;
+                } while(w != v);
+                num_components++;
+            }
+
+            if(depth > 0 && low[v] < low[calls[depth - 1]])
+                low[calls[depth - 1]] = low[v];
+        }
+    }
+
+    _FREE(index);
+    _FREE(low);
+    _FREE(cursor);
+    _FREE(stack);
+    _FREE(calls);
+    _FREE(on_stack);
+
+    return num_components;
+}
+
+/*
+ * Mark the rules that are on a cycle of the graph. A component with more
+ * than one rule is a cycle, and so is a rule that refers to itself.
+ */
+static void find_cycles(graph_t* g, int left_only, int* component, int num_components, char* cyclic) {
+
+    int* size = _ALLOC_ARRAY(int, num_components);
+
+    for(int r = 0; r < g->num_rules; r++)
+        size[component[r]]++;
+
+    for(int r = 0; r < g->num_rules; r++) {
+        cyclic[r] = size[component[r]] > 1;
+        for(int e = g->first[r]; e < g->first[r + 1] && !cyclic[r]; e++)
+            if(g->target[e] == r && (!left_only || g->left[e]))
+                cyclic[r] = 1;
+    }
+
+    _FREE(size);
+}
+
+/*
+ * Find the nullable rules. Every token of every postfix expression is a
+ * node. A catenation becomes nullable when both of its operands are, an
+ * alternation or a '+' when one is, and '?', '*' and code blocks always
+ * are. A non-terminal becomes nullable when its rule does, and a rule
+ * when the root of its expression does.
+ */
+static void find_nullable(graph_t* g, rule_t** rules, char* nullable) {
+
+    int n = g->num_rules;
+    int num_nodes = 0;
+    int num_edges = g->first[n];
+
+    for(int r = 0; r < n; r++)
+        num_nodes += len_ptr_list(rules[r]->expr);
+
+    int* parent = _ALLOC_ARRAY(int, num_nodes + 1);
+    int* pending = _ALLOC_ARRAY(int, num_nodes + 1);
+    char* done = _ALLOC_ARRAY(char, num_nodes + 1);
+    int* root_of = _ALLOC_ARRAY(int, num_nodes + 1); // rule of a root node, or -1
+    int* leaf = _ALLOC_ARRAY(int, num_edges + 1);     // node of each edge
+    int* work = _ALLOC_ARRAY(int, num_nodes + n + 1); // nodes, and rules as -1 - rule
+    int* stack = _ALLOC_ARRAY(int, num_nodes + 1);
+    int wp = 0;
+
+    int node = 0;
+    for(int r = 0; r < n; r++) {
+        int sp = 0;
+        int e = g->first[r];
+        token_t* tok;
+        int tmark = 0;
+
+        while(NULL != (tok = iterate_ptr_list(rules[r]->expr, &tmark))) {
+            parent[node] = -1;
+            root_of[node] = -1;
+            switch(tok->type) {
+                case CATENATE:
+                case PIPE:
+                    parent[stack[--sp]] = node;
+                    parent[stack[--sp]] = node;
+                    pending[node] = (tok->type == CATENATE) ? 2 : 1;
+                    break;
+
+                case QUESTION:
+                case STAR:
+                case PLUS:
+                    parent[stack[--sp]] = node;
+                    pending[node] = 1;
+                    if(tok->type != PLUS) {
+                        done[node] = 1;
+                        work[wp++] = node;
+                    }
+                    break;
+
+                case NON_TERMINAL:
+                    leaf[e++] = node;
+                    pending[node] = 1;
+                    break;
+
+                case CODE_BLOCK:
+                    done[node] = 1;
+                    work[wp++] = node;
+                    break;
+
+                default:
+                    pending[node] = 1; // never
+                    break;
+            }
+            stack[sp++] = node++;
+        }
+
+        if(sp == 0)
+            work[wp++] = -1 - r; // empty rule
+        else
+            root_of[stack[0]] = r;
+    }
+
+    // the non-terminals that refer to each rule
+    int* users = _ALLOC_ARRAY(int, num_edges + 1);
+    int* first_user = _ALLOC_ARRAY(int, n + 1);
+    for(int e = 0; e < num_edges; e++)
+        first_user[g->target[e] + 1]++;
+    for(int r = 0; r < n; r++)
+        first_user[r + 1] += first_user[r];
+    int* fill = _ALLOC_ARRAY(int, n + 1);
+    for(int e = 0; e < num_edges; e++)
+        users[first_user[g->target[e]] + fill[g->target[e]]++] = leaf[e];
+
+    while(wp > 0) {
+        int x = work[--wp];
+
+        if(x < 0) {
+            int r = -1 - x;
+            if(nullable[r])
+                continue;
+            nullable[r] = 1;
+            for(int i = first_user[r]; i < first_user[r + 1]; i++) {
+                int u = users[i];
+                if(!done[u]) {
+                    done[u] = 1;
+                    work[wp++] = u;
+                }
+            }
+        }
+        else if(root_of[x] >= 0)
+            work[wp++] = -1 - root_of[x];
+        else {
+            int p = parent[x];
+            if(!done[p] && --pending[p] == 0) {
+                done[p] = 1;
+                work[wp++] = p;
+            }
+        }
+    }
+
+    _FREE(parent);
+    _FREE(pending);
+    _FREE(done);
+    _FREE(root_of);
+    _FREE(leaf);
+    _FREE(work);
+    _FREE(stack);
+    _FREE(users);
+    _FREE(first_user);
+    _FREE(fill);
+}
+
+recursion_t* find_recursion(parser_state_t* pstate, nfa_t* nfa) {
+
+    recursion_t* rec = _ALLOC_TYPE(recursion_t);
+    graph_t g;
+    rule_t* rule;
+    int mark = 0;
+    int max_len = 0;
+
+    make_graph(&g, pstate, nfa);
+
+    int n = g.num_rules;
+    rule_t** rules = _ALLOC_ARRAY(rule_t*, n + 1);
+    for(int r = 0; NULL != (rule = iterate_ptr_list(pstate->rule_list, &mark)); r++) {
+        rules[r] = rule;
+        if(len_ptr_list(rule->expr) > max_len)
+            max_len = len_ptr_list(rule->expr);
+    }
+
+    rec->num_rules = n;
+    rec->component = _ALLOC_ARRAY(int, n + 1);
+    rec->kind = _ALLOC_ARRAY(recursion_kind_t, n + 1);
+    rec->nullable = _ALLOC_ARRAY(char, n + 1);
+    rec->num_components = find_components(&g, 0, rec->component);
+
+    char* cyclic = _ALLOC_ARRAY(char, n + 1);
+    find_cycles(&g, 0, rec->component, rec->num_components, cyclic);
+
+    find_nullable(&g, rules, rec->nullable);
+
+    term_t* stack = _ALLOC_ARRAY(term_t, max_len + 1);
+    int* next = _ALLOC_ARRAY(int, g.first[n] + 1);
+
+    for(int r = 0; r < n; r++)
+        walk_rule(&g, rules[r], r, rec->nullable, stack, next);
+
+    int* left_component = _ALLOC_ARRAY(int, n + 1);
+    char* left_cyclic = _ALLOC_ARRAY(char, n + 1);
+    int num_left = find_components(&g, 1, left_component);
+    find_cycles(&g, 1, left_component, num_left, left_cyclic);
+
+    for(int r = 0; r < n; r++) {
+        if(left_cyclic[r])
+            rec->kind[r] = RECURSION_LEFT;
+        else if(cyclic[r])
+            rec->kind[r] = RECURSION_RIGHT;
+        else
+            rec->kind[r] = RECURSION_NONE;
+    }
+
+    _FREE(left_component);
+    _FREE(left_cyclic);
+    _FREE(stack);
+    _FREE(next);
+    _FREE(cyclic);
+    _FREE(rules);
+    _FREE(g.first);
+    _FREE(g.target);
+    _FREE(g.left);
+
+    return rec;
+}
+
+void destroy_recursion(recursion_t* rec) {
+
+    if(rec != NULL) {
+        _FREE(rec->component);
+        _FREE(rec->kind);
+        _FREE(rec->nullable);
+        _FREE(rec);
+    }
+}
+
+void dump_recursion(recursion_t* rec, parser_state_t* pstate) {
+
+    static const char* kinds[] = { "not recursive", "right recursive", "left recursive" };
+    int counts[3] = { 0, 0, 0 };
+    rule_t* rule;
+    int mark = 0;
+
+    for(int r = 0; NULL != (rule = iterate_ptr_list(pstate->rule_list, &mark)); r++) {
+        fprintf(stderr, "recursion: %s: %s%s, component %d\n", raw_string(rule->name->str), kinds[rec->kind[r]],
+                rec->nullable[r] ? " (nullable)" : "", rec->component[r]);
+        counts[rec->kind[r]]++;
+    }
+
+    fprintf(stderr, "recursion: %d rules in %d components, %d right recursive, %d left recursive\n", rec->num_rules,
+            rec->num_components, counts[RECURSION_RIGHT], counts[RECURSION_LEFT]);
+}
@@ -1,10 +1,759 @@
 
-#include "to_dfa.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
 
-void post2nfa(void) {
+#include "alloc.h"
+#include "errors.h"
+#include "cmdline.h"
+#include "states.h"
+#include "bitset.h"
+#include "emit.h"
+#include "symtab.h"
+#include "parallel.h"
+#include "hash_map.h"
 
+/*
+ * A fragment is a partially built piece of the NFA. The dangling edges
+ * that still need a target are kept as a linked list that is threaded
+ * through the unused out fields themselves. An edge reference is the
+ * state index shifted left by one, with the low bit selecting out1.
+ */
+typedef struct {
+    int start;
+    int head; // first dangling edge
+    int tail; // last dangling edge
+} frag_t;
+
+/*
+ * The states of one rule while it is lowered. They are numbered from zero
+ * and the symbol of a state is the position of its operand in the postfix
+ * expression, until link_rules() moves them into the NFA. Rules are
+ * lowered on their own, so they can be lowered at the same time.
+ */
+typedef struct {
+    nfa_state_t* states;
+    int num_states;
+    int cap_states;
+    int start;
+} piece_t;
+
+// the scratch space of one thread while it lowers rules
+typedef struct {
+    arena_t* arena; // the states of the pieces
+    frag_t* stack;
+} lower_worker_t;
+
+typedef struct {
+    rule_t** rules;
+    piece_t* pieces;
+    lower_worker_t* workers;
+} lower_job_t;
+
+static inline int* edge(piece_t* p, int ref) {
+
+    nfa_state_t* s = &p->states[ref >> 1];
+    return (ref & 1) ? &s->out1 : &s->out;
+}
+
+static void patch(piece_t* p, int ref, int target) {
+
+    while(ref != -1) {
+        int* e = edge(p, ref);
+        ref = *e;
+        *e = target;
+    }
+}
+
+static int new_state(piece_t* p, nfa_type_t type, int symbol, int out, int out1) {
+
+    if(p->num_states >= p->cap_states)
+        FATAL("internal error: NFA arena overflow (%d states)", p->cap_states);
+
+    nfa_state_t* s = &p->states[p->num_states];
+    s->type = type;
+    s->symbol = symbol;
+    s->out = out;
+    s->out1 = out1;
+
+    return p->num_states++;
+}
+
+static symbol_t* intern_symbol(nfa_t* nfa, token_t* tok) {
+
+    // every code block is unique, so they are never looked up
+    if(tok->type != CODE_BLOCK && nfa->by_id[tok->id] != NULL)
+        return nfa->by_id[tok->id];
+
+    symbol_t* sym = _ARENA_TYPE(nfa->arena, symbol_t);
+    sym->tok = tok;
+    sym->index = len_ptr_list(nfa->symbols);
+    sym->rule = -1;
+    append_ptr_list(nfa->symbols, sym);
+
+    if(tok->type != CODE_BLOCK)
+        nfa->by_id[tok->id] = sym;
+
+    return sym;
+}
+
+static frag_t pop_frag(frag_t* stack, int* sp, rule_t* rule) {
+
+    if(*sp <= 0)
+        FATAL("internal error: NFA stack underflow in rule \"%s\"", raw_string(rule->name->str));
+
+    return stack[--(*sp)];
+}
+
+// Thompson's construction over one postfix expression. The stack is
+// supplied by the caller so it can be reused for every rule.
+static int lower_rule(piece_t* p, rule_t* rule, frag_t* stack) {
+
+    int sp = 0;
+    int mark = 0;
+    token_t* tok;
+    frag_t e1, e2;
+    int s;
+
+#define PUSH(f) (stack[sp++] = (f))
+#define POP() pop_frag(stack, &sp, rule)
+
+    while(NULL != (tok = iterate_ptr_list(rule->expr, &mark))) {
+        switch(tok->type) {
+            case CATENATE:
+                e2 = POP();
+                e1 = POP();
+                patch(p, e1.head, e2.start);
+                PUSH(((frag_t){ e1.start, e2.head, e2.tail }));
+                break;
+
+            case PIPE:
+                e2 = POP();
+                e1 = POP();
+                s = new_state(p, NFA_SPLIT, 0, e1.start, e2.start);
+                *edge(p, e1.tail) = e2.head;
+                PUSH(((frag_t){ s, e1.head, e2.tail }));
+                break;
+
+            case QUESTION:
+                e1 = POP();
+                s = new_state(p, NFA_SPLIT, 0, e1.start, -1);
+                *edge(p, e1.tail) = (s << 1) | 1;
+                PUSH(((frag_t){ s, e1.head, (s << 1) | 1 }));
+                break;
+
+            case STAR:
+                e1 = POP();
+                s = new_state(p, NFA_SPLIT, 0, e1.start, -1);
+                patch(p, e1.head, s);
+                PUSH(((frag_t){ s, (s << 1) | 1, (s << 1) | 1 }));
+                break;
+
+            case PLUS:
+                e1 = POP();
+                s = new_state(p, NFA_SPLIT, 0, e1.start, -1);
+                patch(p, e1.head, s);
+                PUSH(((frag_t){ e1.start, (s << 1) | 1, (s << 1) | 1 }));
+                break;
+
+            case NON_TERMINAL:
+            case TERMINAL_SYMBOL:
+            case TERMINAL_KEYWORD:
+            case TERMINAL_OPER:
+            case CODE_BLOCK:
+                s = new_state(p, NFA_SYMBOL, mark - 1, -1, -1);
+                PUSH(((frag_t){ s, s << 1, s << 1 }));
+                break;
+
+            default:
+                FATAL("internal error: unexpected token type in postfix expression: %s", tok_to_str(tok->type));
+        }
+    }
+
+    int match = new_state(p, NFA_MATCH, 0, -1, -1);
+
+    if(sp == 0)
+        return match; // empty rule
+
+    e1 = POP();
+    if(sp != 0)
+        FATAL("internal error: %d unused fragments in rule \"%s\"", sp, raw_string(rule->name->str));
+
+    patch(p, e1.head, match);
+    return e1.start;
+
+#undef PUSH
+#undef POP
+}
+
+static void lower_task(void* data, int task, int worker) {
+
+    lower_job_t* job = data;
+    piece_t* p = &job->pieces[task];
+    lower_worker_t* w = &job->workers[worker];
+
+    p->cap_states = len_ptr_list(job->rules[task]->expr) + 1;
+    p->states = _ARENA_ARRAY(w->arena, nfa_state_t, p->cap_states);
+    p->start = lower_rule(p, job->rules[task], w->stack);
+}
+
+/*
+ * Move the pieces into the NFA in the order of the rules. The symbols are
+ * interned here, in the order that the operands appear, so the NFA is the
+ * same whatever the number of threads.
+ */
+static void link_rules(nfa_t* nfa, rule_t** rules, piece_t* pieces) {
+
+    for(int r = 0; r < nfa->num_rules; r++) {
+        piece_t* p = &pieces[r];
+        int base = nfa->num_states;
+
+        nfa->rule_base[r] = base;
+        nfa->rule_start[r] = base + p->start;
+
+        for(int i = 0; i < p->num_states; i++) {
+            nfa_state_t* s = &nfa->states[base + i];
+            *s = p->states[i];
+            if(s->out >= 0)
+                s->out += base;
+            if(s->out1 >= 0)
+                s->out1 += base;
+
+            if(s->type == NFA_SYMBOL) {
+                token_t* tok = index_ptr_list(rules[r]->expr, s->symbol);
+                symbol_t* sym = intern_symbol(nfa, tok);
+                if(tok->type == NON_TERMINAL && sym->rule < 0) {
+                    fprintf(stderr, "grammar error: %d: undefined non-terminal \"%s\"\n", tok->line_no,
+                            raw_string(tok->str));
+                    nfa->errors++;
+                }
+                s->symbol = sym->index;
+            }
+        }
+
+        nfa->num_states += p->num_states;
+    }
+
+    nfa->rule_base[nfa->num_rules] = nfa->num_states;
+}
+
+/*
+ * Convert the postfix expression of every rule into NFA fragments. All of
+ * the states come from one arena that is sized up front. Every operand and
+ * every operator other than CATENATE makes exactly one state, plus one
+ * match state for each rule. The rules are lowered on up to threads
+ * threads and then linked in order.
+ */
+nfa_t* post2nfa(parser_state_t* pstate, int threads) {
+
+    nfa_t* nfa = _ALLOC_TYPE(nfa_t);
+    rule_t* rule;
+    int mark = 0;
+    int max_len = 0;
+
+    nfa->num_rules = len_ptr_list(pstate->rule_list);
+    nfa->cap_states = 0;
+    while(NULL != (rule = iterate_ptr_list(pstate->rule_list, &mark))) {
+        int len = len_ptr_list(rule->expr);
+        nfa->cap_states += len + 1;
+        if(len > max_len)
+            max_len = len;
+    }
+
+    nfa->states = _ALLOC_ARRAY(nfa_state_t, nfa->cap_states);
+    nfa->rule_start = _ALLOC_ARRAY(int, nfa->num_rules);
+    nfa->rule_base = _ALLOC_ARRAY(int, nfa->num_rules + 1);
+    nfa->symbols = create_ptr_list();
+    nfa->by_id = _ALLOC_ARRAY(symbol_t*, len_symtab(pstate->symtab) + 1);
+    nfa->arena = create_arena(1 << 12);
+
+    // symbol zero always matches
+    append_ptr_list(nfa->symbols, NULL);
+
+    // define every rule before lowering so that forward references resolve
+    mark = 0;
+    for(int i = 0; NULL != (rule = iterate_ptr_list(pstate->rule_list, &mark)); i++) {
+        symbol_t* sym = intern_symbol(nfa, rule->name);
+        if(sym->rule >= 0) {
+            fprintf(stderr, "grammar error: %d: non-terminal \"%s\" is already defined\n", rule->name->line_no,
+                    raw_string(rule->name->str));
+            nfa->errors++;
+        }
+        else
+            sym->rule = i;
+    }
+
+    lower_job_t job;
+    int workers = num_workers(threads, nfa->num_rules);
+    job.rules = _ALLOC_ARRAY(rule_t*, nfa->num_rules + 1);
+    job.pieces = _ALLOC_ARRAY(piece_t, nfa->num_rules + 1);
+    job.workers = _ALLOC_ARRAY(lower_worker_t, workers);
+    for(int w = 0; w < workers; w++) {
+        job.workers[w].arena = create_arena(1 << 16);
+        job.workers[w].stack = _ALLOC_ARRAY(frag_t, max_len + 1);
+    }
+
+    mark = 0;
+    for(int i = 0; NULL != (rule = iterate_ptr_list(pstate->rule_list, &mark)); i++)
+        job.rules[i] = rule;
+
+    run_parallel(workers, nfa->num_rules, lower_task, &job);
+    link_rules(nfa, job.rules, job.pieces);
+
+    for(int w = 0; w < workers; w++) {
+        destroy_arena(job.workers[w].arena);
+        _FREE(job.workers[w].stack);
+    }
+    _FREE(job.workers);
+    _FREE(job.pieces);
+    _FREE(job.rules);
+
+    if(nfa->errors != 0) {
+        destroy_nfa(nfa);
+        return NULL;
+    }
+
+    return nfa;
+}
+
+void destroy_nfa(nfa_t* nfa) {
+
+    if(nfa != NULL) {
+        destroy_ptr_list(nfa->symbols);
+        destroy_arena(nfa->arena);
+        _FREE(nfa->by_id);
+        _FREE(nfa->states);
+        _FREE(nfa->rule_start);
+        _FREE(nfa->rule_base);
+        _FREE(nfa);
+    }
+}
+
+const char* symbol_name(pointer_list_t* symbols, int index) {
+
+    symbol_t* sym = index_ptr_list(symbols, index);
+
+    if(sym == NULL)
+        return "(always)";
+    else if(sym->tok->type == CODE_BLOCK)
+        return "{...}";
+    else
+        return raw_string(sym->tok->str);
+}
+
+void dump_nfa(nfa_t* nfa) {
+
+    for(int r = 0; r < nfa->num_rules; r++) {
+        fprintf(stderr, "nfa: rule %d: start %d\n", r, nfa->rule_start[r]);
+        for(int i = nfa->rule_base[r]; i < nfa->rule_base[r + 1]; i++) {
+            nfa_state_t* s = &nfa->states[i];
+            switch(s->type) {
+                case NFA_SYMBOL:
+                    fprintf(stderr, "    %4d: %s -> %d\n", i, symbol_name(nfa->symbols, s->symbol), s->out);
+                    break;
+                case NFA_SPLIT:
+                    fprintf(stderr, "    %4d: split -> %d, %d\n", i, s->out, s->out1);
+                    break;
+                case NFA_MATCH:
+                    fprintf(stderr, "    %4d: match\n", i);
+                    break;
+            }
+        }
+    }
+}
+
+/*
+ * Subset construction is done one rule at a time. The NFA states of a
+ * rule are contiguous in the arena, so a set only needs one bit for each
+ * state of that rule. New DFA states are found through a hash map from
+ * the set to the state.
+ *
+ * A set never holds the states of two rules, so the rules share nothing
+ * and each one is built into a DFA of its own, on any thread. The DFAs
+ * of the rules are then joined in the order of the rules, which numbers
+ * the states the same way whatever the number of threads.
+ */
+typedef struct {
+    nfa_t* nfa;
+    dfa_t* dfa;
+    int rule;
+    int base;  // first NFA state of the rule
+    int size;  // number of NFA states in the rule
+    int words; // words in one set
+    int first; // first DFA state of the rule
+    uint64_t* closure; // cached epsilon closure of each NFA state
+    unsigned char* have_closure;
+    int* stack;
+    uint64_t* sets; // set of each DFA state of the rule
+    int cap_sets;
+    hash_map_t* index; // set -> DFA state
+} subset_t;
+
+#define SET_OF(ss, n) (&(ss)->sets[(size_t)(n) * (ss)->words])
+
+static uint64_t* closure(subset_t* ss, int state) {
+
+    int local = state - ss->base;
+    uint64_t* set = &ss->closure[(size_t)local * ss->words];
+
+    if(ss->have_closure[local])
+        return set;
+
+    int sp = 0;
+    bits_clear(set, ss->words);
+    bits_set(set, local);
+    ss->stack[sp++] = local;
+
+    while(sp > 0) {
+        nfa_state_t* s = &ss->nfa->states[ss->base + ss->stack[--sp]];
+        if(s->type == NFA_SPLIT) {
+            int outs[2] = { s->out, s->out1 };
+            for(int i = 0; i < 2; i++) {
+                if(outs[i] >= 0 && !bits_test(set, outs[i] - ss->base)) {
+                    bits_set(set, outs[i] - ss->base);
+                    ss->stack[sp++] = outs[i] - ss->base;
+                }
+            }
+        }
+    }
+
+    ss->have_closure[local] = 1;
+    return set;
+}
+
+static int add_dfa_state(dfa_t* dfa, int rule) {
+
+    if(dfa->num_states + 1 > dfa->cap_states) {
+        dfa->cap_states <<= 1;
+        dfa->states = _REALLOC_ARRAY(dfa->states, dfa_state_t, dfa->cap_states);
+    }
+
+    dfa_state_t* st = &dfa->states[dfa->num_states];
+    st->rule = rule;
+    st->accept = 0;
+    st->trans = 0;
+    st->num_trans = 0;
+
+    return dfa->num_states++;
+}
+
+static void add_dfa_trans(dfa_t* dfa, int symbol, int target) {
+
+    if(dfa->num_trans + 1 > dfa->cap_trans) {
+        dfa->cap_trans <<= 1;
+        dfa->trans = _REALLOC_ARRAY(dfa->trans, dfa_trans_t, dfa->cap_trans);
+    }
+
+    dfa->trans[dfa->num_trans].symbol = symbol;
+    dfa->trans[dfa->num_trans].target = target;
+    dfa->num_trans++;
+}
+
+static uint32_t set_hash(const void* set, size_t size) {
+
+    return (uint32_t)bits_hash(set, size / sizeof(uint64_t));
+}
+
+// Return the DFA state for the set, creating it if it is new.
+static int find_or_add_set(subset_t* ss, const uint64_t* set) {
+
+    int added;
+    int* state = insert_hash_map(ss->index, set, &added);
+    if(!added)
+        return *state;
+
+    *state = add_dfa_state(ss->dfa, ss->rule);
+    int local = *state - ss->first;
+
+    if(local + 1 > ss->cap_sets) {
+        while(local + 1 > ss->cap_sets)
+            ss->cap_sets <<= 1;
+        ss->sets = _REALLOC_ARRAY(ss->sets, uint64_t, (size_t)ss->cap_sets * ss->words);
+    }
+    memcpy(SET_OF(ss, local), set, ss->words * sizeof(uint64_t));
+
+    return *state;
+}
+
+// returns the start state of the rule
+static int subset_rule(subset_t* ss, int* sym_slot, int* pending_sym, uint64_t* pending) {
+
+    nfa_t* nfa = ss->nfa;
+    dfa_t* dfa = ss->dfa;
+    int words = ss->words;
+
+    int start = find_or_add_set(ss, closure(ss, nfa->rule_start[ss->rule]));
+
+    // the states that are added while this runs are the work list
+    for(int d = ss->first; d < dfa->num_states; d++) {
+        uint64_t* set = SET_OF(ss, d - ss->first);
+        int accept = 0;
+        int np = 0;
+
+        // gather the targets of every symbol in the order of the grammar
+        for(int s = bits_next(set, words, 0); s >= 0; s = bits_next(set, words, s + 1)) {
+            nfa_state_t* st = &nfa->states[ss->base + s];
+            if(st->type == NFA_MATCH)
+                accept = 1;
+            else if(st->type == NFA_SYMBOL) {
+                int k = sym_slot[st->symbol];
+                if(k < 0) {
+                    k = sym_slot[st->symbol] = np++;
+                    pending_sym[k] = st->symbol;
+                    bits_clear(&pending[(size_t)k * words], words);
+                }
+                bits_or(&pending[(size_t)k * words], closure(ss, st->out), words);
+            }
+        }
+
+        dfa->states[d].accept = accept;
+        dfa->states[d].trans = dfa->num_trans;
+        dfa->states[d].num_trans = np;
+
+        for(int k = 0; k < np; k++) {
+            int target = find_or_add_set(ss, &pending[(size_t)k * words]);
+            add_dfa_trans(dfa, pending_sym[k], target);
+            sym_slot[pending_sym[k]] = -1;
+        }
+    }
+
+    return start;
+}
+
+static dfa_t* create_dfa(int cap) {
+
+    dfa_t* dfa = _ALLOC_TYPE(dfa_t);
+    dfa->cap_states = cap;
+    dfa->states = _ALLOC_ARRAY(dfa_state_t, dfa->cap_states);
+    dfa->cap_trans = cap;
+    dfa->trans = _ALLOC_ARRAY(dfa_trans_t, dfa->cap_trans);
+
+    return dfa;
+}
+
+// the DFA of one rule, with its states numbered from zero
+typedef struct {
+    dfa_t* dfa;
+    int start;
+} rule_dfa_t;
+
+typedef struct {
+    nfa_t* nfa;
+    rule_dfa_t* rules;
+    int** sym_slot; // one for each thread, every entry is -1 between states
+} subset_job_t;
+
+static void subset_task(void* data, int task, int worker) {
+
+    subset_job_t* job = data;
+    nfa_t* nfa = job->nfa;
+    int r = task;
+
+    subset_t ss;
+    ss.nfa = nfa;
+    ss.dfa = create_dfa(1 << 4);
+    ss.rule = r;
+    ss.base = nfa->rule_base[r];
+    ss.size = nfa->rule_base[r + 1] - ss.base;
+    ss.words = BITS_WORDS(ss.size);
+    ss.first = 0;
+    ss.closure = _ALLOC_ARRAY(uint64_t, (size_t)ss.size * ss.words);
+    ss.have_closure = _ALLOC_ARRAY(unsigned char, ss.size);
+    ss.stack = _ALLOC_ARRAY(int, ss.size);
+    ss.cap_sets = 1 << 4;
+    ss.sets = _ALLOC_ARRAY(uint64_t, (size_t)ss.cap_sets * ss.words);
+    ss.index = create_hash_map(ss.words * sizeof(uint64_t), sizeof(int), set_hash, NULL);
+
+    // a DFA state can not have more distinct symbols than the rule has states
+    int* pending_sym = _ALLOC_ARRAY(int, ss.size);
+    uint64_t* pending = _ALLOC_ARRAY(uint64_t, (size_t)ss.size * ss.words);
+
+    job->rules[r].start = subset_rule(&ss, job->sym_slot[worker], pending_sym, pending);
+    job->rules[r].dfa = ss.dfa;
+
+    _FREE(pending);
+    _FREE(pending_sym);
+    destroy_hash_map(ss.index);
+    _FREE(ss.sets);
+    _FREE(ss.stack);
+    _FREE(ss.have_closure);
+    _FREE(ss.closure);
+}
+
+/*
+ * Convert the NFA of every rule into a DFA using the subset construction.
+ * A non-terminal is an ordinary symbol here. It becomes a call to the
+ * other rule when the states are traversed. The rules are built on up to
+ * threads threads.
+ */
+dfa_t* nfa2dfa(nfa_t* nfa, int threads) {
+
+    subset_job_t job;
+    int num_symbols = len_ptr_list(nfa->symbols);
+    int workers = num_workers(threads, nfa->num_rules);
+
+    job.nfa = nfa;
+    job.rules = _ALLOC_ARRAY(rule_dfa_t, nfa->num_rules + 1);
+    job.sym_slot = _ALLOC_ARRAY(int*, workers);
+    for(int w = 0; w < workers; w++) {
+        job.sym_slot[w] = _ALLOC_ARRAY(int, num_symbols + 1);
+        for(int i = 0; i < num_symbols; i++)
+            job.sym_slot[w][i] = -1;
+    }
+
+    run_parallel(workers, nfa->num_rules, subset_task, &job);
+
+    int num_states = 0;
+    int num_trans = 0;
+    for(int r = 0; r < nfa->num_rules; r++) {
+        num_states += job.rules[r].dfa->num_states;
+        num_trans += job.rules[r].dfa->num_trans;
+    }
+
+    dfa_t* dfa = create_dfa(1 << 6);
+    while(dfa->cap_states < num_states)
+        dfa->cap_states <<= 1;
+    while(dfa->cap_trans < num_trans)
+        dfa->cap_trans <<= 1;
+    dfa->states = _REALLOC_ARRAY(dfa->states, dfa_state_t, dfa->cap_states);
+    dfa->trans = _REALLOC_ARRAY(dfa->trans, dfa_trans_t, dfa->cap_trans);
+    dfa->num_rules = nfa->num_rules;
+    dfa->rule_start = _ALLOC_ARRAY(int, nfa->num_rules);
+    dfa->symbols = nfa->symbols;
+
+    // join the rules in order
+    for(int r = 0; r < nfa->num_rules; r++) {
+        dfa_t* part = job.rules[r].dfa;
+        int first = dfa->num_states;
+
+        dfa->rule_start[r] = first + job.rules[r].start;
+        for(int d = 0; d < part->num_states; d++) {
+            dfa_state_t* st = &dfa->states[dfa->num_states++];
+            *st = part->states[d];
+            st->trans += dfa->num_trans;
+        }
+        for(int t = 0; t < part->num_trans; t++) {
+            dfa_trans_t* tr = &dfa->trans[dfa->num_trans++];
+            *tr = part->trans[t];
+            tr->target += first;
+        }
+
+        destroy_dfa(part);
+    }
+
+    for(int w = 0; w < workers; w++)
+        _FREE(job.sym_slot[w]);
+    _FREE(job.sym_slot);
+    _FREE(job.rules);
+
+    return dfa;
+}
+
+void destroy_dfa(dfa_t* dfa) {
+
+    if(dfa != NULL) {
+        _FREE(dfa->states);
+        _FREE(dfa->trans);
+        _FREE(dfa->rule_start);
+        _FREE(dfa);
+    }
+}
+
+void dump_dfa(dfa_t* dfa) {
+
+    for(int r = 0; r < dfa->num_rules; r++)
+        fprintf(stderr, "dfa: rule %d: start %d\n", r, dfa->rule_start[r]);
+
+    for(int i = 0; i < dfa->num_states; i++) {
+        dfa_state_t* st = &dfa->states[i];
+        fprintf(stderr, "    %4d: rule %d%s\n", i, st->rule, st->accept ? " accept" : "");
+        for(int t = st->trans; t < st->trans + st->num_trans; t++)
+            fprintf(stderr, "          %s -> %d\n", symbol_name(dfa->symbols, dfa->trans[t].symbol),
+                    dfa->trans[t].target);
+    }
+}
+
+/*
+ * The output file is named by -o, or else it is the name of the input
+ * file with the extension replaced.
+ */
+static string_t* output_name(parser_state_t* pstate, const char* ext) {
+
+    const char* opt = raw_string(get_cmd_opt("output"));
+    if(opt != NULL && opt[0] != '\0')
+        return create_string(opt);
+
+    const char* fname = pstate->fname;
+    const char* base = strrchr(fname, '/');
+    base = (base != NULL) ? base + 1 : fname;
+
+    const char* dot = strrchr(base, '.');
+    int len = (dot != NULL) ? (int)(dot - base) : (int)strlen(base);
+
+    return create_string_fmt("%.*s%s", len, base, ext);
 }
 
-void nfa2dfa(void) {
+int make_states(parser_state_t* pstate) {
+
+    const char* format = raw_string(get_cmd_opt("format"));
+    if(strcmp(format, "heap") != 0 && strcmp(format, "code") != 0 && strcmp(format, "comb") != 0) {
+        fprintf(stderr, "unknown output format \"%s\"\n", format);
+        return 1;
+    }
+
+    int threads = (int)strtol(raw_string(get_cmd_opt("threads")), NULL, 10);
 
-}
\ No newline at end of file
+    nfa_t* nfa = post2nfa(pstate, threads);
+    if(nfa == NULL)
+        return 1;
+
+    if(in_cmd_list("dump", "nfa"))
+        dump_nfa(nfa);
+
+    recursion_t* rec = find_recursion(pstate, nfa);
+    if(in_cmd_list("dump", "recursion"))
+        dump_recursion(rec, pstate);
+
+    dfa_t* dfa = nfa2dfa(nfa, threads);
+    dfa->recursion = rec;
+    dfa_t* min = minimize_dfa(dfa);
+    if(in_cmd_list("dump", "minimize"))
+        fprintf(stderr, "%s: %d states before minimizing, %d after\n", pstate->fname, dfa->num_states,
+                min->num_states);
+    destroy_dfa(dfa);
+    dfa = min;
+
+    if(in_cmd_list("dump", "dfa"))
+        dump_dfa(dfa);
+
+    first_sets_t* sets = make_first_sets(dfa);
+    if(in_cmd_list("dump", "first"))
+        dump_first_sets(sets, dfa);
+
+    int errors = 0;
+    heap_image_t* img = create_heap_image(dfa, sets);
+    string_t* fname;
+
+    if(strcmp(format, "code") == 0) {
+        fname = output_name(pstate, ".c");
+        errors += emit_code(img, pstate, raw_string(fname));
+    }
+    else if(strcmp(format, "comb") == 0) {
+        fname = output_name(pstate, ".comb");
+        errors += emit_comb(img, dfa, raw_string(fname));
+    }
+    else {
+        fname = output_name(pstate, ".heap");
+        errors += emit_heap(img, raw_string(fname));
+    }
+
+    destroy_string(fname);
+    destroy_heap_image(img);
+    destroy_first_sets(sets);
+    destroy_recursion(rec);
+    destroy_dfa(dfa);
+    destroy_nfa(nfa);
+
+    return errors;
+}
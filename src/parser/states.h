@@ -1,8 +1,134 @@
 #ifndef _STATES_H_
 #define _STATES_H_
 
-void make_states(void);
-void post2nfa(void);
-void nfa2dfa(void);
+#include <stdint.h>
+
+#include "parser.h"
+#include "pointer_list.h"
+#include "alloc.h"
+#include "tokens.h"
+
+/*
+ * A symbol is anything that can label an NFA edge. Terminals and
+ * non-terminals are interned by name. Every code block is its own symbol.
+ * Symbol zero is reserved for "always match".
+ */
+typedef struct {
+    token_t* tok;
+    int index; // index of this symbol in the symbol list
+    int rule;  // index of the rule that defines a non-terminal, else -1
+} symbol_t;
+
+typedef enum {
+    NFA_SYMBOL,
+    NFA_SPLIT,
+    NFA_MATCH,
+} nfa_type_t;
+
+/*
+ * Thompson NFA state. States are referenced by index into the arena so
+ * the whole NFA can be allocated once and serialized later.
+ */
+typedef struct {
+    nfa_type_t type;
+    int symbol; // symbol index for NFA_SYMBOL
+    int out;    // next state, or -1
+    int out1;   // second edge of a NFA_SPLIT, or -1
+} nfa_state_t;
+
+typedef struct {
+    nfa_state_t* states; // the arena
+    int num_states;
+    int cap_states;
+    int* rule_start; // start state of each rule
+    int* rule_base;  // first arena index owned by each rule, plus an end mark
+    int num_rules;
+    pointer_list_t* symbols; // list of symbol_t*
+    symbol_t** by_id;        // symbol of each interned name, or NULL
+    arena_t* arena;          // the symbols are allocated here
+    int errors;              // grammar errors found while lowering
+} nfa_t;
+
+typedef enum {
+    RECURSION_NONE,
+    RECURSION_RIGHT, // every cycle matches a token before it comes back
+    RECURSION_LEFT,  // the rule can call itself before it matches a token
+} recursion_kind_t;
+
+/*
+ * Recursion of every rule, found on the rule graph before the rules are
+ * lowered. Components are the strongly connected components of the graph,
+ * numbered so that a component only refers to itself and to components
+ * with lower numbers.
+ */
+typedef struct {
+    int num_rules;
+    int num_components;
+    int* component;
+    recursion_kind_t* kind;
+    char* nullable;
+} recursion_t;
+
+typedef struct {
+    int symbol;
+    int target;
+} dfa_trans_t;
+
+/*
+ * The transitions of a DFA state are contiguous in the transition array
+ * and are kept in the order that the grammar gives the alternatives.
+ */
+typedef struct {
+    int rule;   // rule that the state was built for
+    int accept; // the rule can finish in this state
+    int trans;  // index of the first transition
+    int num_trans;
+} dfa_state_t;
+
+typedef struct {
+    dfa_state_t* states;
+    int num_states;
+    int cap_states;
+    dfa_trans_t* trans;
+    int num_trans;
+    int cap_trans;
+    int* rule_start; // start state of each rule
+    int num_rules;
+    pointer_list_t* symbols; // borrowed from the NFA
+    recursion_t* recursion;  // recursion of every rule, borrowed
+} dfa_t;
+
+/*
+ * Nullable, FIRST and FOLLOW sets of every rule and of every DFA state,
+ * as bit sets over the symbol list. Bit zero of a FOLLOW set is the end
+ * of the input.
+ */
+typedef struct {
+    int words; // words in each set
+    int num_rules;
+    int num_states;
+    char* nullable;
+    uint64_t* first;
+    uint64_t* follow;
+    char* state_nullable;
+    uint64_t* state_first;
+} first_sets_t;
+
+int make_states(parser_state_t* pstate);
+const char* symbol_name(pointer_list_t* symbols, int index);
+nfa_t* post2nfa(parser_state_t* pstate, int threads);
+void destroy_nfa(nfa_t* nfa);
+void dump_nfa(nfa_t* nfa);
+dfa_t* nfa2dfa(nfa_t* nfa, int threads);
+void destroy_dfa(dfa_t* dfa);
+void dump_dfa(dfa_t* dfa);
+dfa_t* minimize_dfa(dfa_t* dfa);
+first_sets_t* make_first_sets(dfa_t* dfa);
+void destroy_first_sets(first_sets_t* sets);
+void dump_first_sets(first_sets_t* sets, dfa_t* dfa);
+recursion_t* find_recursion(parser_state_t* pstate, nfa_t* nfa);
+void destroy_recursion(recursion_t* rec);
+void dump_recursion(recursion_t* rec, parser_state_t* pstate);
+int trans_first(first_sets_t* sets, dfa_t* dfa, dfa_trans_t* tr, uint64_t* set);
 
 #endif /* _STATES_H_ */
@@ -0,0 +1,63 @@
+#include <stdint.h>
+
+#include "alloc.h"
+#include "errors.h"
+#include "symtab.h"
+
+symtab_t* create_symtab(void) {
+
+    symtab_t* tab = _ALLOC_TYPE(symtab_t);
+    tab->index = create_hashtable();
+    tab->names = create_ptr_list();
+
+    return tab;
+}
+
+void destroy_symtab(symtab_t* tab) {
+
+    char* name;
+    int mark = 0;
+
+    if(tab != NULL) {
+        while(NULL != (name = iterate_ptr_list(tab->names, &mark)))
+            _FREE(name);
+        destroy_ptr_list(tab->names);
+        destroy_hashtable(tab->index);
+        _FREE(tab);
+    }
+}
+
+// returns the id of the key, adding it if it is new
+int intern_symtab(symtab_t* tab, const char* key) {
+
+    void* data;
+
+    if(find_hashtable(tab->index, key, &data))
+        return (int)(intptr_t)data;
+
+    int id = len_ptr_list(tab->names);
+    append_ptr_list(tab->names, _COPY_STRING(key));
+    insert_hashtable(tab->index, key, (void*)(intptr_t)id);
+
+    return id;
+}
+
+// returns -1 if the key was never interned
+int find_symtab(symtab_t* tab, const char* key) {
+
+    void* data;
+    return find_hashtable(tab->index, key, &data) ? (int)(intptr_t)data : -1;
+}
+
+const char* name_symtab(symtab_t* tab, int id) {
+
+    if(id < 0 || id >= len_ptr_list(tab->names))
+        FATAL("internal error: symbol id %d is out of range", id);
+
+    return index_ptr_list(tab->names, id);
+}
+
+int len_symtab(symtab_t* tab) {
+
+    return len_ptr_list(tab->names);
+}
@@ -0,0 +1,24 @@
+/*
+ * The grammar symbol table. The name of every terminal and non-terminal
+ * is interned once, as the scanner makes its token, and gets a dense id.
+ * Later passes index arrays by the id instead of hashing the name again.
+ */
+#ifndef _SYMTAB_H_
+#define _SYMTAB_H_
+
+#include "hash.h"
+#include "pointer_list.h"
+
+typedef struct {
+    hash_table_t* index;   // key -> id
+    pointer_list_t* names; // id -> key
+} symtab_t;
+
+symtab_t* create_symtab(void);
+void destroy_symtab(symtab_t* tab);
+int intern_symtab(symtab_t* tab, const char* key);
+int find_symtab(symtab_t* tab, const char* key);
+const char* name_symtab(symtab_t* tab, int id);
+int len_symtab(symtab_t* tab);
+
+#endif /* _SYMTAB_H_ */
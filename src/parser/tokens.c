@@ -1,101 +1,266 @@
 
+#include <ctype.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 #include "alloc.h"
 #include "tokens.h"
 #include "parser.h"
 #include "errors.h"
-#include "cmdline.h"
-#include "fileio.h"
+#include "context.h"
 #include "scanner.h"
+#include "symtab.h"
 
-static token_t* token = NULL;
+/*
+ * The token that the scanner just read lives in the scan arena, which is
+ * reset every time the token is consumed. The tokens of the rules and the
+ * operators that expression() adds live in the grammar arena until every
+ * phase that reads the rules is done. The strings of a token in an arena
+ * are never changed.
+ *
+ * The grammar file is mapped and flex scans it in place. The mapping is
+ * private, so flex can write the ends of its tokens into it, and it has
+ * the two zero bytes that flex wants at the end. A code block is not
+ * copied at all, its token refers to the text in the mapping.
+ */
+static char* map_input(const char* fname, size_t* size) {
 
-void init_scanner(void) {
+    int fd = open(fname, O_RDONLY);
+    if(fd < 0)
+        return NULL;
 
-    const char* fname = find_file(raw_string(get_cmd_opt("files")), ".g");
-    if(fname != NULL) {
-        yyin = fopen(fname, "r");
-        if(yyin == NULL) {
-            fprintf(stderr, "cannot open input file \"%s\": %s\n", fname, strerror(errno));
-            cmdline_help();
-        }
+    struct stat sb;
+    if(fstat(fd, &sb) != 0) {
+        close(fd);
+        return NULL;
     }
-    else
-        FATAL("internal error in %s: parse command line failed", __func__);
+
+    // the zero pages under the file supply the end marks when the size
+    // of the file is a multiple of the page size
+    char* ptr = mmap(NULL, sb.st_size + 2, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(ptr == MAP_FAILED) {
+        close(fd);
+        return NULL;
+    }
+
+    if(sb.st_size > 0
+       && mmap(ptr, sb.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+        int err = errno;
+        munmap(ptr, sb.st_size + 2);
+        close(fd);
+        errno = err;
+        return NULL;
+    }
+
+    close(fd);
+    *size = sb.st_size;
+    return ptr;
 }
 
-token_t* create_token(const char* str, token_type_t type) {
+// returns non-zero with errno set if the file can not be read
+int init_scanner(compile_t* ctx, const char* fname) {
+
+    ctx->input = map_input(fname, &ctx->input_size);
+    if(ctx->input == NULL)
+        return 1;
+
+    ctx->scan_arena = create_arena(1 << 12);
+    ctx->grammar_arena = create_arena(1 << 16);
+
+    if(yylex_init_extra(ctx, &ctx->scanner) != 0)
+        FATAL("internal error: cannot create the scanner: %s", strerror(errno));
+    ctx->input_buffer = yy_scan_buffer(ctx->input, ctx->input_size + 2, ctx->scanner);
+
+    // yy_scan_buffer() does not set the line number of the new buffer
+    yyset_lineno(1, ctx->scanner);
+
+    return 0;
+}
+
+static string_t* arena_string(arena_t* arena, const char* str, int len) {
+
+    string_t* ptr = _ARENA_TYPE(arena, string_t);
+    ptr->len = len;
+    ptr->cap = len + 1;
+
+    // most names fit in the string itself
+    ptr->buffer = (ptr->cap <= STRING_LOCAL) ? ptr->local : _ARENA_ARRAY(arena, char, ptr->cap);
+    memcpy(ptr->buffer, str, len);
+    ptr->buffer[len] = '\0';
+
+    return ptr;
+}
+
+// a string that refers to text that outlives the arena, without a copy
+static string_t* slice_string(arena_t* arena, const char* str, int len) {
+
+    string_t* ptr = _ARENA_TYPE(arena, string_t);
+    ptr->buffer = (char*)str;
+    ptr->len = len;
+    ptr->cap = len + 1;
+
+    return ptr;
+}
+
+/*
+ * The type name of a terminal, as in "TERM_%s" with the quotes and the
+ * white space around the text taken out.
+ */
+static string_t* term_name(arena_t* arena, const char* str, int len, int upper) {
+
+    while(len > 0 && isspace((unsigned char)*str)) {
+        str++;
+        len--;
+    }
+
+    while(len > 0 && isspace((unsigned char)str[len - 1]))
+        len--;
 
-    token_t* tok = _ALLOC_TYPE(token_t);
-    tok->str = create_string(str);
-    tok->line_no = yylineno;
+    string_t* ptr = _ARENA_TYPE(arena, string_t);
+    ptr->buffer = (len + 6 <= STRING_LOCAL) ? ptr->local : _ARENA_ARRAY(arena, char, len + 6);
+    strcpy(ptr->buffer, "TERM_");
+
+    char* out = ptr->buffer + 5;
+    for(int i = 0; i < len; i++)
+        if(str[i] != '\'')
+            *out++ = upper ? toupper((unsigned char)str[i]) : str[i];
+
+    ptr->len = out - ptr->buffer;
+    ptr->cap = len + 6;
+
+    return ptr;
+}
+
+static token_t* new_token(compile_t* ctx, arena_t* arena, string_t* str, token_type_t type) {
+
+    token_t* tok = _ARENA_TYPE(arena, token_t);
+    tok->str = str;
+    tok->line_no = yyget_lineno(ctx->scanner);
     tok->type = type;
 
     switch(type) {
-        case TERMINAL_SYMBOL: {
-            tok->ptype = create_string_fmt("TERM_%s", str);
-        } break;
+        case TERMINAL_SYMBOL:
+            tok->ptype = term_name(arena, str->buffer, str->len, 0);
+            break;
 
-        case TERMINAL_KEYWORD: {
-            string_t* tmp = create_string_fmt("TERM_%s", str);
-            strip_char(tmp, '\'');
-            upcase(tmp);
-            tok->ptype = tmp;
-        } break;
+        case TERMINAL_KEYWORD:
+            tok->ptype = term_name(arena, str->buffer, str->len, 1);
+            break;
 
         case TERMINAL_OPER: {
-            string_t* tmp = create_string_fmt("TERM_%s", str);
+            string_t* tmp = create_string_fmt("TERM_%s", str->buffer);
             strip_char(tmp, '\'');
-            tok->ptype = convert(tmp);
+            string_t* conv = convert(tmp);
+            tok->ptype = arena_string(arena, conv->buffer, conv->len);
+            destroy_string(conv);
             destroy_string(tmp);
         } break;
 
-        default:
-            tok->ptype = create_string(tok_to_str(type));
-            break;
+        default: {
+            const char* name = tok_to_str(type);
+            tok->ptype = slice_string(arena, name, strlen(name));
+        } break;
     }
 
+    // non-terminals are lower case and terminal types are upper case, so
+    // the two can share the table without colliding.
+    if(type == NON_TERMINAL)
+        tok->id = intern_symtab(ctx->pstate->symtab, raw_string(tok->str));
+    else if(type == TERMINAL_SYMBOL || type == TERMINAL_KEYWORD || type == TERMINAL_OPER)
+        tok->id = intern_symtab(ctx->pstate->symtab, raw_string(tok->ptype));
+    else
+        tok->id = -1;
+
     return tok;
 }
 
-void destroy_token(token_t* tok) {
+// a token read by the scanner, good until it is consumed
+token_t* create_token(compile_t* ctx, const char* str, int len, token_type_t type) {
 
-    if(tok != NULL) {
-        destroy_string(tok->str);
-        destroy_string(tok->ptype);
-        _FREE(tok);
-    }
+    return new_token(ctx, ctx->scan_arena, arena_string(ctx->scan_arena, str, len), type);
+}
+
+/*
+ * A code block of len characters at str in the scanner buffer. The
+ * closing brace after it is not read again, so the text is ended in
+ * place and the token refers to it for as long as the file is mapped.
+ */
+token_t* create_block_token(compile_t* ctx, char* str, int len) {
+
+    str[len] = '\0';
+    return new_token(ctx, ctx->scan_arena, slice_string(ctx->scan_arena, str, len), CODE_BLOCK);
 }
 
-token_t* get_token(void) {
+// an operator token that is kept in a postfix expression
+token_t* create_expr_token(compile_t* ctx, const char* str, token_type_t type) {
 
-    //fprintf(stderr, "get: \"%s\" \"%s\"\n", token->str->buffer, token->ptype->buffer);
-    return token;
+    return new_token(ctx, ctx->grammar_arena, slice_string(ctx->grammar_arena, str, strlen(str)), type);
 }
 
-void set_token(token_t* tok) {
+token_t* get_token(compile_t* ctx) {
 
-    token = tok;
+    //fprintf(stderr, "get: \"%s\" \"%s\"\n", ctx->token->str->buffer, ctx->token->ptype->buffer);
+    return ctx->token;
 }
 
-token_t* copy_token(token_t* tok) {
+void set_token(compile_t* ctx, token_t* tok) {
 
-    token_t* ptr = _ALLOC_TYPE(token_t);
+    ctx->token = tok;
+}
+
+// copy a token into the grammar arena
+token_t* copy_token(compile_t* ctx, token_t* tok) {
+
+    arena_t* grammar_arena = ctx->grammar_arena;
+    token_t* ptr = _ARENA_TYPE(grammar_arena, token_t);
     ptr->line_no = tok->line_no;
     ptr->type = tok->type;
-    ptr->ptype = copy_string(tok->ptype);
-    ptr->str = copy_string(tok->str);
+    ptr->id = tok->id;
+
+    // only the names of terminals are made by the scanner, the others
+    // are constants
+    if(tok->type == TERMINAL_SYMBOL || tok->type == TERMINAL_KEYWORD || tok->type == TERMINAL_OPER)
+        ptr->ptype = arena_string(grammar_arena, tok->ptype->buffer, tok->ptype->len);
+    else
+        ptr->ptype = slice_string(grammar_arena, tok->ptype->buffer, tok->ptype->len);
+
+    // a code block is already in the mapped file
+    if(tok->type == CODE_BLOCK || tok->type == CATENATE || tok->type == PIPE)
+        ptr->str = slice_string(grammar_arena, tok->str->buffer, tok->str->len);
+    else
+        ptr->str = arena_string(grammar_arena, tok->str->buffer, tok->str->len);
 
     return ptr;
 }
 
-token_t* consume_token(void) {
+// free every token at once, when nothing reads the rules any more
+void destroy_tokens(compile_t* ctx) {
+
+    if(ctx->input != NULL) {
+        yy_delete_buffer(ctx->input_buffer, ctx->scanner);
+        yylex_destroy(ctx->scanner);
+        munmap(ctx->input, ctx->input_size + 2);
+        ctx->input = NULL;
+        ctx->input_buffer = NULL;
+        ctx->scanner = NULL;
+    }
+
+    destroy_arena(ctx->scan_arena);
+    destroy_arena(ctx->grammar_arena);
+    ctx->scan_arena = ctx->grammar_arena = NULL;
+    ctx->token = NULL;
+}
+
+token_t* consume_token(compile_t* ctx) {
 
-    //if(token!= NULL) fprintf(stderr, "consume: \"%s\" \"%s\"\n", token->str->buffer, token->ptype->buffer);
-    destroy_token(token);
-    if(yylex() != 0)
-        return token;
+    //if(ctx->token != NULL) fprintf(stderr, "consume: \"%s\" \"%s\"\n", ctx->token->str->buffer, ctx->token->ptype->buffer);
+    reset_arena(ctx->scan_arena);
+    if(yylex(ctx->scanner) != 0)
+        return ctx->token;
     else {
-        token = NULL;
+        ctx->token = NULL;
         return NULL;
     }
 }
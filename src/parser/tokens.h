@@ -34,15 +34,20 @@ typedef struct {
     string_t* ptype;
     token_type_t type;
     int line_no;
+    int id; // interned name of a terminal or non-terminal, else -1
 } token_t;
 
-void init_scanner(void);
-token_t* create_token(const char* str, token_type_t type);
-void destroy_token(token_t* tok);
-token_t* get_token(void);
-void set_token(token_t* tok);
-token_t* copy_token(token_t* tok);
-token_t* consume_token(void);
+typedef struct _compile_t_ compile_t;
+
+int init_scanner(compile_t* ctx, const char* fname);
+token_t* create_token(compile_t* ctx, const char* str, int len, token_type_t type);
+token_t* create_block_token(compile_t* ctx, char* str, int len);
+token_t* create_expr_token(compile_t* ctx, const char* str, token_type_t type);
+void destroy_tokens(compile_t* ctx);
+token_t* get_token(compile_t* ctx);
+void set_token(compile_t* ctx, token_t* tok);
+token_t* copy_token(compile_t* ctx, token_t* tok);
+token_t* consume_token(compile_t* ctx);
 const char* tok_to_str(token_type_t type);
 
 #endif /* _TOKENS_H_ */
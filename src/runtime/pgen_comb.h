@@ -0,0 +1,142 @@
+/*
+ * Layout of the compressed transition tables that pgen writes with
+ * "-f comb". Like the state heap, the file is a flat array of unsigned 32
+ * bit words that can be mapped and used as it is.
+ *
+ *      header
+ *      symbol table (the same as in the state heap)
+ *      state array
+ *      entry array
+ *      call array
+ *      FIRST sets (the same as in the state heap)
+ *      string table
+ *
+ * A state here is a state of the DFA of one rule, not a heap state. The
+ * terminal transitions of all of the states are packed together into the
+ * entry array with the double displacement method. The entry for state s
+ * and terminal t is entries[states[s].base + t], and it belongs to s only
+ * if its check is s. When it does not, the transitions of the default
+ * state are looked up the same way. A default state never has a default
+ * of its own, so a lookup reads at most two entries.
+ *
+ * The non-terminal and code block transitions of a state are kept in the
+ * call array in the order that the grammar gives them. The rank of a
+ * terminal transition is the number of calls that come before it, so the
+ * parser tries the alternatives in the same order as with the heap.
+ */
+#ifndef _PGEN_COMB_H_
+#define _PGEN_COMB_H_
+
+#include <stdint.h>
+
+#include "pgen_heap.h"
+
+#define PGEN_COMB_MAGIC 0x424d4350u // "PCMB" in a little endian file
+#define PGEN_COMB_VERSION 2
+
+#define PGEN_COMB_NONE 0xffffffffu
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t size; // size of the whole file in bytes
+    uint32_t num_terminals;
+    uint32_t num_rules;
+    uint32_t num_actions;
+    uint32_t num_symbols;
+    uint32_t num_states;
+    uint32_t num_entries;
+    uint32_t num_calls;
+    uint32_t start_rule;   // symbol of the start rule
+    uint32_t symbol_table; // byte offset of the symbol table
+    uint32_t state_table;  // byte offset of the state array
+    uint32_t entry_table;  // byte offset of the entry array
+    uint32_t call_table;   // byte offset of the call array
+    uint32_t num_first;
+    uint32_t first_words;  // words in each FIRST set
+    uint32_t first_table;  // byte offset of the FIRST sets
+    uint32_t string_table; // byte offset of the string table
+    uint32_t string_size;  // size of the string table in bytes
+} pgen_comb_header_t;
+
+typedef struct {
+    uint32_t base;      // entry index of terminal zero
+    uint32_t fallback;  // default state, or PGEN_COMB_NONE
+    uint32_t calls;     // index of the first call
+    uint32_t num_calls;
+    uint32_t accept;    // the rule can finish in this state
+} pgen_comb_state_t;
+
+typedef struct {
+    uint32_t check; // state that owns the entry, or PGEN_COMB_NONE
+    uint32_t next;
+    uint32_t rank;  // number of calls that are tried first
+} pgen_comb_entry_t;
+
+typedef struct {
+    uint32_t symbol; // non-terminal or code block
+    uint32_t next;
+    uint32_t first; // FIRST set number plus one, or zero
+} pgen_comb_call_t;
+
+static inline const pgen_symbol_t* pgen_comb_symbols(const pgen_comb_header_t* comb) {
+
+    return (const pgen_symbol_t*)((const char*)comb + comb->symbol_table);
+}
+
+static inline const pgen_comb_state_t* pgen_comb_states(const pgen_comb_header_t* comb) {
+
+    return (const pgen_comb_state_t*)((const char*)comb + comb->state_table);
+}
+
+static inline const pgen_comb_entry_t* pgen_comb_entries(const pgen_comb_header_t* comb) {
+
+    return (const pgen_comb_entry_t*)((const char*)comb + comb->entry_table);
+}
+
+static inline const pgen_comb_call_t* pgen_comb_calls(const pgen_comb_header_t* comb) {
+
+    return (const pgen_comb_call_t*)((const char*)comb + comb->call_table);
+}
+
+static inline int pgen_comb_first_test(const pgen_comb_header_t* comb, uint32_t set, uint32_t terminal) {
+
+    const uint32_t* words = (const uint32_t*)((const char*)comb + comb->first_table) + set * comb->first_words;
+    return terminal <= comb->num_terminals && ((words[terminal >> 5] >> (terminal & 31)) & 1);
+}
+
+static inline const char* pgen_comb_string(const pgen_comb_header_t* comb, uint32_t offset) {
+
+    return (const char*)comb + comb->string_table + offset;
+}
+
+/*
+ * Find the transition of a state on a terminal. The entry array is padded
+ * so that base + terminal is inside of it for every terminal up to
+ * num_terminals. Returns NULL if the terminal is out of that range or the
+ * state has no transition on it.
+ */
+static inline const pgen_comb_entry_t* pgen_comb_lookup(const pgen_comb_header_t* comb, uint32_t state,
+                                                        uint32_t terminal) {
+
+    const pgen_comb_state_t* states = pgen_comb_states(comb);
+    const pgen_comb_entry_t* entries = pgen_comb_entries(comb);
+
+    if(terminal > comb->num_terminals)
+        return NULL;
+
+    const pgen_comb_entry_t* e = &entries[states[state].base + terminal];
+    if(e->check == state)
+        return e;
+
+    uint32_t fallback = states[state].fallback;
+    if(fallback != PGEN_COMB_NONE) {
+        e = &entries[states[fallback].base + terminal];
+        if(e->check == fallback)
+            return e;
+    }
+
+    return NULL;
+}
+
+#endif /* _PGEN_COMB_H_ */
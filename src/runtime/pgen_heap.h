@@ -0,0 +1,175 @@
+/*
+ * Layout of the state heap that pgen writes and a generated parser reads.
+ *
+ * The file is a flat array of unsigned 32 bit words in native byte order.
+ * It is laid out so that it can be mapped with mmap() and used read-only
+ * as it is. Nothing in it is a pointer. Sections are found by their byte
+ * offset from the start of the file, states refer to each other by index,
+ * and names are byte offsets into the string table.
+ *
+ *      header
+ *      symbol table (terminals first)
+ *      state array
+ *      dispatch array
+ *      dispatch words
+ *      FIRST sets
+ *      string table
+ *
+ * Symbol zero always matches. Terminals are numbered from one, so the
+ * scanner of a generated parser hands the parser the terminal number as
+ * the token. The non-terminals follow in the order of the rules, then the
+ * code blocks.
+ *
+ * A state tests one symbol. When it matches, the parser goes to the
+ * match_state, otherwise it goes to the no_match_state. State zero is the
+ * "no match" state and state one is the "match" state of the rule that
+ * is being parsed.
+ *
+ * A DFA state with many terminal transitions would be a long chain of
+ * states that each test one terminal. The first state of such a chain has
+ * a dispatch instead, which finds the state in the chain that tests the
+ * current token with one lookup. A dense dispatch is a table indexed by
+ * the terminal. A sorted dispatch is a sorted array of terminals and an
+ * array of states, and it is searched with binary search. Only one state
+ * in the chain can match the token, so the other states of the chain go
+ * straight to the end of the chain when they do not match.
+ *
+ * A state that tests a non-terminal or a code block can have a FIRST set.
+ * That is the set of terminals that the rest of the rule can start with
+ * when it goes through this state. When the current token is not in it,
+ * the state can not lead to a match and the parser goes on to the
+ * no_match_state without trying it. A set is a bit for each terminal
+ * number, packed into words.
+ */
+#ifndef _PGEN_HEAP_H_
+#define _PGEN_HEAP_H_
+
+#include <stdint.h>
+
+#define PGEN_HEAP_MAGIC 0x4e484750u // "PGHN" in a little endian file
+#define PGEN_HEAP_VERSION 3
+
+#define PGEN_STATE_NO_MATCH 0
+#define PGEN_STATE_MATCH 1
+#define PGEN_FIRST_STATE 2
+
+typedef enum {
+    PGEN_SYM_ALWAYS,
+    PGEN_SYM_TERMINAL,
+    PGEN_SYM_NON_TERMINAL,
+    PGEN_SYM_ACTION,
+} pgen_symbol_type_t;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t size;          // size of the whole file in bytes
+    uint32_t num_terminals; // terminals are symbols 1 to num_terminals
+    uint32_t num_rules;     // non-terminals follow the terminals
+    uint32_t num_actions;   // code blocks follow the non-terminals
+    uint32_t num_symbols;
+    uint32_t num_states;
+    uint32_t start_rule;   // symbol of the start rule
+    uint32_t symbol_table; // byte offset of the symbol table
+    uint32_t state_table;  // byte offset of the state array
+    uint32_t num_dispatch;
+    uint32_t num_dispatch_words;
+    uint32_t dispatch_table; // byte offset of the dispatch array
+    uint32_t dispatch_words; // byte offset of the dispatch words
+    uint32_t num_first;
+    uint32_t first_words;  // words in each FIRST set
+    uint32_t first_table;  // byte offset of the FIRST sets
+    uint32_t string_table; // byte offset of the string table
+    uint32_t string_size;  // size of the string table in bytes
+} pgen_heap_header_t;
+
+typedef struct {
+    uint32_t type; // pgen_symbol_type_t
+    uint32_t name; // string offset of the name, such as TERM_WHILE
+    uint32_t text; // string offset of the text in the grammar
+    uint32_t data; // entry state of a non-terminal, else zero
+} pgen_symbol_t;
+
+typedef struct {
+    uint32_t state_number; // index of this state, used for error checking
+    uint32_t terminal;     // symbol to test, zero always matches
+    uint32_t match_state;
+    uint32_t no_match_state;
+    uint32_t error_state; // zero selects the no match state
+    uint32_t dispatch;    // dispatch number plus one, or zero
+    uint32_t first;       // FIRST set number plus one, or zero
+} pgen_state_t;
+
+typedef enum {
+    PGEN_DISPATCH_DENSE,
+    PGEN_DISPATCH_SORTED,
+} pgen_dispatch_type_t;
+
+typedef struct {
+    uint32_t type;  // pgen_dispatch_type_t
+    uint32_t low;   // dense: terminal of the first slot
+    uint32_t count; // dense: number of slots, sorted: number of terminals
+    uint32_t words; // index of the first dispatch word
+    uint32_t miss;  // state to go to when no terminal matches
+} pgen_dispatch_t;
+
+static inline const pgen_symbol_t* pgen_heap_symbols(const pgen_heap_header_t* heap) {
+
+    return (const pgen_symbol_t*)((const char*)heap + heap->symbol_table);
+}
+
+static inline const pgen_state_t* pgen_heap_states(const pgen_heap_header_t* heap) {
+
+    return (const pgen_state_t*)((const char*)heap + heap->state_table);
+}
+
+static inline const pgen_dispatch_t* pgen_heap_dispatch(const pgen_heap_header_t* heap) {
+
+    return (const pgen_dispatch_t*)((const char*)heap + heap->dispatch_table);
+}
+
+static inline const uint32_t* pgen_heap_dispatch_words(const pgen_heap_header_t* heap) {
+
+    return (const uint32_t*)((const char*)heap + heap->dispatch_words);
+}
+
+/*
+ * Find the state that tests a terminal in a dispatch. Returns zero when
+ * the terminal is not tested there.
+ */
+static inline uint32_t pgen_dispatch_find(const pgen_heap_header_t* heap, const pgen_dispatch_t* d,
+                                          uint32_t terminal) {
+
+    const uint32_t* words = pgen_heap_dispatch_words(heap) + d->words;
+
+    if(d->type == PGEN_DISPATCH_DENSE) {
+        uint32_t slot = terminal - d->low; // wraps around when terminal < low
+        return (slot < d->count) ? words[slot] : 0;
+    }
+
+    uint32_t lo = 0;
+    uint32_t hi = d->count;
+    while(lo < hi) {
+        uint32_t mid = (lo + hi) / 2;
+        if(words[mid] < terminal)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    return (lo < d->count && words[lo] == terminal) ? words[d->count + lo] : 0;
+}
+
+// test if a terminal is in a FIRST set, by set number
+static inline int pgen_first_test(const pgen_heap_header_t* heap, uint32_t set, uint32_t terminal) {
+
+    const uint32_t* words = (const uint32_t*)((const char*)heap + heap->first_table) + set * heap->first_words;
+    return terminal <= heap->num_terminals && ((words[terminal >> 5] >> (terminal & 31)) & 1);
+}
+
+static inline const char* pgen_heap_string(const pgen_heap_header_t* heap, uint32_t offset) {
+
+    return (const char*)heap + heap->string_table + offset;
+}
+
+#endif /* _PGEN_HEAP_H_ */
@@ -0,0 +1,810 @@
+/*
+ * Table driven parser runtime.
+ *
+ * This walks the state heap as the notes describe. A state tests one
+ * symbol. A terminal matches the current token, a non-terminal is a call
+ * to the entry state of its rule, and a code block always matches. On a
+ * match the parser goes to the match_state and on a miss it goes to the
+ * no_match_state. A state with a dispatch goes straight to the state of
+ * its chain that tests the current token.
+ *
+ * Before following a match, the no_match_state is pushed on the choice
+ * stack with the input position, so that when the rest of the rule fails
+ * the parser backs up and tries the next alternative. When a rule
+ * reaches its match state, the choices it made are dropped and the rule
+ * is finished. When a rule runs out of choices it fails, and the caller
+ * goes on to its own next alternative.
+ *
+ * A rule that is called again at the same position before it returns is
+ * left recursive. That call fails, which lets the other alternatives of
+ * the rule be tried instead of looping.
+ *
+ * A call or a code block whose FIRST set does not have the current token
+ * is passed over without pushing a choice, since it could only fail. Code
+ * blocks that such an alternative starts with are not run.
+ *
+ * With a memo, the result of every call is kept by rule and position, and
+ * a rule that is called again at the same position is not parsed again.
+ * Its code blocks are not run again either. A result can only be kept if
+ * it does not depend on the left recursion guard of a call outside of
+ * it. The depends field of a frame is the lowest frame whose guard turned
+ * down a call while the rule was being parsed. A refused call can only
+ * belong to a frame that started at the same position, and a rule is
+ * active at most once at a position, so finding it is a short search.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "pgenrt.h"
+
+static int check_header(const pgen_heap_header_t* heap, size_t size) {
+
+    if(size < sizeof(pgen_heap_header_t))
+        return 0;
+
+    if(heap->magic != PGEN_HEAP_MAGIC || heap->version != PGEN_HEAP_VERSION || heap->size > size)
+        return 0;
+
+    if(heap->num_states < PGEN_FIRST_STATE
+       || heap->num_symbols != 1 + heap->num_terminals + heap->num_rules + heap->num_actions)
+        return 0;
+
+    uint64_t symbols = (uint64_t)heap->symbol_table + (uint64_t)heap->num_symbols * sizeof(pgen_symbol_t);
+    uint64_t states = (uint64_t)heap->state_table + (uint64_t)heap->num_states * sizeof(pgen_state_t);
+    uint64_t dispatch = (uint64_t)heap->dispatch_table + (uint64_t)heap->num_dispatch * sizeof(pgen_dispatch_t);
+    uint64_t words = (uint64_t)heap->dispatch_words + (uint64_t)heap->num_dispatch_words * sizeof(uint32_t);
+    uint64_t first = (uint64_t)heap->first_table + (uint64_t)heap->num_first * heap->first_words * sizeof(uint32_t);
+    uint64_t strings = (uint64_t)heap->string_table + heap->string_size;
+
+    return symbols <= heap->state_table && states <= heap->dispatch_table && dispatch <= heap->dispatch_words
+            && words <= heap->first_table && first <= heap->string_table && strings <= heap->size
+            && heap->first_words >= (heap->num_terminals + 32) / 32 && (heap->symbol_table & 3) == 0
+            && (heap->state_table & 3) == 0 && (heap->dispatch_table & 3) == 0 && (heap->dispatch_words & 3) == 0
+            && (heap->first_table & 3) == 0;
+}
+
+// map a whole file read-only, the pages are shared by every process that maps it
+static void* map_file(const char* fname, size_t* size) {
+
+    int fd = open(fname, O_RDONLY);
+    if(fd < 0)
+        return NULL;
+
+    struct stat sb;
+    if(fstat(fd, &sb) != 0 || sb.st_size == 0) {
+        close(fd);
+        return NULL;
+    }
+
+    void* ptr = mmap(NULL, sb.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(ptr == MAP_FAILED)
+        return NULL;
+
+    *size = sb.st_size;
+    return ptr;
+}
+
+/*
+ * Map a heap file. Returns NULL if the file can not be mapped or if it is
+ * not a heap of this version.
+ */
+const pgen_heap_header_t* pgen_open_heap(const char* fname) {
+
+    size_t size;
+    const pgen_heap_header_t* heap = map_file(fname, &size);
+    if(heap == NULL)
+        return NULL;
+
+    // pgen_close_heap() unmaps the size in the header
+    if(!check_header(heap, size) || heap->size != size) {
+        munmap((void*)heap, size);
+        return NULL;
+    }
+
+    return heap;
+}
+
+void pgen_close_heap(const pgen_heap_header_t* heap) {
+
+    if(heap != NULL)
+        munmap((void*)heap, heap->size);
+}
+
+/*
+ * Check every reference in the heap. This touches every page, so it is
+ * meant for tests and tools rather than for start up.
+ */
+int pgen_check_heap(const pgen_heap_header_t* heap, size_t size) {
+
+    if(!check_header(heap, size))
+        return 0;
+
+    const pgen_symbol_t* symbols = pgen_heap_symbols(heap);
+    const pgen_state_t* states = pgen_heap_states(heap);
+
+    for(uint32_t i = 0; i < heap->num_symbols; i++) {
+        if(symbols[i].name >= heap->string_size || symbols[i].text >= heap->string_size)
+            return 0;
+        if(symbols[i].type == PGEN_SYM_NON_TERMINAL && symbols[i].data >= heap->num_states)
+            return 0;
+    }
+
+    for(uint32_t i = 0; i < heap->num_states; i++) {
+        if(states[i].state_number != i || states[i].terminal >= heap->num_symbols
+           || states[i].match_state >= heap->num_states || states[i].no_match_state >= heap->num_states
+           || states[i].error_state >= heap->num_states || states[i].dispatch > heap->num_dispatch
+           || states[i].first > heap->num_first)
+            return 0;
+    }
+
+    const pgen_dispatch_t* dispatch = pgen_heap_dispatch(heap);
+    const uint32_t* words = pgen_heap_dispatch_words(heap);
+
+    for(uint32_t i = 0; i < heap->num_dispatch; i++) {
+        const pgen_dispatch_t* d = &dispatch[i];
+        uint64_t size = (d->type == PGEN_DISPATCH_DENSE) ? d->count : 2 * (uint64_t)d->count;
+
+        if(d->type > PGEN_DISPATCH_SORTED || d->count == 0 || d->words + size > heap->num_dispatch_words
+           || d->miss >= heap->num_states)
+            return 0;
+
+        // every target must test the terminal that finds it
+        for(uint32_t k = 0; k < d->count; k++) {
+            uint32_t term = (d->type == PGEN_DISPATCH_DENSE) ? d->low + k : words[d->words + k];
+            uint32_t target = (d->type == PGEN_DISPATCH_DENSE) ? words[d->words + k] : words[d->words + d->count + k];
+            if(target != 0 && (target >= heap->num_states || states[target].terminal != term))
+                return 0;
+            if(d->type == PGEN_DISPATCH_SORTED && k > 0 && words[d->words + k - 1] >= term)
+                return 0;
+        }
+    }
+
+    return heap->start_rule > heap->num_terminals && heap->start_rule <= heap->num_terminals + heap->num_rules;
+}
+
+#define NO_DEPENDS 0xffffffffu
+
+static void memo_free(pgen_memo_t* memo) {
+
+    free(memo->entries);
+    memo->entries = NULL;
+    memo->mask = 0;
+}
+
+// the size is rounded down to a power of two, zero turns the memo off
+static int memo_resize(pgen_memo_t* memo, uint32_t size) {
+
+    memo_free(memo);
+    if(size == 0)
+        return 1;
+
+    uint32_t cap = 1;
+    while(cap <= size / 2)
+        cap <<= 1;
+
+    memo->entries = calloc(cap, sizeof(pgen_memo_entry_t));
+    if(memo->entries == NULL)
+        return 0;
+
+    memo->mask = cap - 1;
+    memo->generation = 0;
+    return 1;
+}
+
+// entries of earlier parses are told apart by their generation
+static void memo_start(pgen_memo_t* memo) {
+
+    if(memo->entries != NULL && ++memo->generation == 0) {
+        memset(memo->entries, 0, (memo->mask + 1) * sizeof(pgen_memo_entry_t));
+        memo->generation = 1;
+    }
+}
+
+static inline pgen_memo_entry_t* memo_slot(pgen_memo_t* memo, uint32_t rule, uint32_t pos) {
+
+    uint32_t h = pos * 0x9e3779b1u ^ rule * 0x85ebca77u;
+    return &memo->entries[(h ^ (h >> 16)) & memo->mask];
+}
+
+static inline const pgen_memo_entry_t* memo_find(pgen_memo_t* memo, uint32_t rule, uint32_t pos) {
+
+    if(memo->entries == NULL)
+        return NULL;
+
+    pgen_memo_entry_t* m = memo_slot(memo, rule, pos);
+    return (m->generation == memo->generation && m->rule == rule && m->pos == pos) ? m : NULL;
+}
+
+static inline void memo_store(pgen_memo_t* memo, uint32_t rule, uint32_t pos, uint32_t end) {
+
+    if(memo->entries != NULL)
+        *memo_slot(memo, rule, pos) = (pgen_memo_entry_t){ memo->generation, rule, pos, end };
+}
+
+/*
+ * Create a parser for a heap. The stacks start out deep enough for depth
+ * nested calls and are kept for every parse that follows.
+ */
+pgen_parser_t* pgen_create_parser(const pgen_heap_header_t* heap, uint32_t depth) {
+
+    pgen_parser_t* parser = calloc(1, sizeof(pgen_parser_t));
+    if(parser == NULL)
+        return NULL;
+
+    if(depth < 16)
+        depth = 16;
+
+    parser->heap = heap;
+    parser->states = pgen_heap_states(heap);
+    parser->symbols = pgen_heap_symbols(heap);
+    parser->cap_frames = depth;
+    parser->frames = malloc(depth * sizeof(pgen_frame_t));
+    parser->cap_choices = depth * 4;
+    parser->choices = malloc(parser->cap_choices * sizeof(pgen_choice_t));
+    parser->active = calloc(heap->num_rules + 1, sizeof(uint32_t));
+
+    if(parser->frames == NULL || parser->choices == NULL || parser->active == NULL) {
+        pgen_destroy_parser(parser);
+        return NULL;
+    }
+
+    return parser;
+}
+
+void pgen_destroy_parser(pgen_parser_t* parser) {
+
+    if(parser != NULL) {
+        free(parser->frames);
+        free(parser->choices);
+        free(parser->active);
+        memo_free(&parser->memo);
+        free(parser);
+    }
+}
+
+void pgen_set_action(pgen_parser_t* parser, pgen_action_t action, void* data) {
+
+    parser->action = action;
+    parser->data = data;
+}
+
+/*
+ * Keep the results of rules in a memo of at most size entries, so that no
+ * rule is parsed twice at the same position. The memo is a cache, and an
+ * entry may be replaced by another, so a parse is linear in time only when
+ * the memo has room for every rule at every position. Returns zero if the
+ * memo can not be allocated.
+ */
+int pgen_set_memo(pgen_parser_t* parser, uint32_t size) {
+
+    return memo_resize(&parser->memo, size);
+}
+
+// only called when a parse goes deeper than any before it
+static int grow(void** buffer, uint32_t* cap, size_t size) {
+
+    void* ptr = realloc(*buffer, (size_t)*cap * 2 * size);
+    if(ptr == NULL)
+        return 0;
+
+    *buffer = ptr;
+    *cap *= 2;
+    return 1;
+}
+
+/*
+ * The left recursion guard refused a call of rule at pos, so the result of
+ * the top frame depends on the frame of the active call.
+ */
+#define GUARD_DEPENDS(frames, num_frames, rule, pos)                                             \
+    do {                                                                                         \
+        uint32_t i_ = (num_frames) - 1;                                                          \
+        while((frames)[i_].rule != (rule) || (frames)[i_].pos != (pos))                          \
+            i_--;                                                                                \
+        if(i_ < (frames)[(num_frames) - 1].depends)                                              \
+            (frames)[(num_frames) - 1].depends = i_;                                             \
+    } while(0)
+
+/*
+ * Keep the result of the frame that was just popped if it stands on its
+ * own, otherwise pass what it depends on to the caller.
+ */
+#define FINISH_FRAME(memo, frames, f, num_frames, end)                                           \
+    do {                                                                                         \
+        if((f)->depends >= (num_frames))                                                         \
+            memo_store((memo), (f)->rule, (f)->pos, (end));                                      \
+        else if((f)->depends < (frames)[(num_frames) - 1].depends)                               \
+            (frames)[(num_frames) - 1].depends = (f)->depends;                                   \
+    } while(0)
+
+#define PUSH_CHOICE(s, p)                                                                        \
+    do {                                                                                         \
+        if(num_choices >= parser->cap_choices                                                    \
+           && !grow((void**)&parser->choices, &parser->cap_choices, sizeof(pgen_choice_t)))      \
+            goto out_of_memory;                                                                  \
+        parser->choices[num_choices].state = (s);                                                \
+        parser->choices[num_choices].pos = (p);                                                  \
+        num_choices++;                                                                           \
+    } while(0)
+
+/*
+ * Parse the tokens with the start rule. Returns the number of tokens that
+ * the start rule matched, or -1 if it did not match. On failure,
+ * pgen_error_pos() gives the farthest position that was reached, which
+ * is where the syntax error is.
+ */
+long pgen_parse(pgen_parser_t* parser, const uint32_t* tokens, uint32_t num_tokens) {
+
+    const pgen_heap_header_t* heap = parser->heap;
+    const pgen_state_t* states = parser->states;
+    const pgen_symbol_t* symbols = parser->symbols;
+    const pgen_dispatch_t* dispatch = pgen_heap_dispatch(heap);
+    const uint32_t num_terminals = heap->num_terminals;
+    const uint32_t first_rule = num_terminals + 1;
+    const uint32_t first_action = first_rule + heap->num_rules;
+
+    uint32_t num_frames = 0;
+    uint32_t num_choices = 0;
+    uint32_t pos = 0;
+    uint32_t farthest = 0;
+    uint32_t pc;
+
+    memset(parser->active, 0, heap->num_rules * sizeof(uint32_t));
+    memo_start(&parser->memo);
+
+    // the start rule is called with no calling state
+    parser->frames[num_frames++]
+            = (pgen_frame_t){ PGEN_STATE_NO_MATCH, 0, heap->start_rule - first_rule, 0, 0, NO_DEPENDS };
+    parser->active[heap->start_rule - first_rule] = 1;
+    pc = symbols[heap->start_rule].data;
+
+    for(;;) {
+        if(pc >= PGEN_FIRST_STATE) {
+            const pgen_state_t* st = &states[pc];
+            uint32_t sym = st->terminal;
+
+            if(st->dispatch != 0) {
+                // find the one state of the chain that can match
+                const pgen_dispatch_t* d = &dispatch[st->dispatch - 1];
+                uint32_t target = (pos < num_tokens) ? pgen_dispatch_find(heap, d, tokens[pos]) : 0;
+
+                if(target == 0) {
+                    pc = d->miss;
+                    continue;
+                }
+
+                st = &states[target];
+                sym = st->terminal;
+            }
+
+            if(sym <= num_terminals) {
+                if(sym == 0 || (pos < num_tokens && tokens[pos] == sym)) {
+                    if(st->no_match_state != PGEN_STATE_NO_MATCH)
+                        PUSH_CHOICE(st->no_match_state, pos);
+                    if(sym != 0 && ++pos > farthest)
+                        farthest = pos;
+                    pc = st->match_state;
+                }
+                else
+                    pc = st->no_match_state;
+            }
+            else if(st->first != 0 && (pos >= num_tokens || !pgen_first_test(heap, st->first - 1, tokens[pos])))
+                pc = st->no_match_state; // the token can not start this alternative
+            else if(sym < first_action) {
+                uint32_t rule = sym - first_rule;
+
+                if(parser->active[rule] == pos + 1) {
+                    GUARD_DEPENDS(parser->frames, num_frames, rule, pos);
+                    pc = st->no_match_state; // left recursion
+                    continue;
+                }
+
+                const pgen_memo_entry_t* m = memo_find(&parser->memo, rule, pos);
+                if(m != NULL) {
+                    if(m->end == PGEN_MEMO_FAIL)
+                        pc = st->no_match_state;
+                    else {
+                        if(st->no_match_state != PGEN_STATE_NO_MATCH)
+                            PUSH_CHOICE(st->no_match_state, pos);
+                        pos = m->end;
+                        pc = st->match_state;
+                    }
+                    continue;
+                }
+
+                if(num_frames >= parser->cap_frames
+                   && !grow((void**)&parser->frames, &parser->cap_frames, sizeof(pgen_frame_t)))
+                    goto out_of_memory;
+
+                parser->frames[num_frames++]
+                        = (pgen_frame_t){ pc, pos, rule, num_choices, parser->active[rule], NO_DEPENDS };
+                parser->active[rule] = pos + 1;
+                pc = symbols[sym].data;
+            }
+            else {
+                if(parser->action != NULL)
+                    parser->action(sym - first_action, pos, parser->data);
+                if(st->no_match_state != PGEN_STATE_NO_MATCH)
+                    PUSH_CHOICE(st->no_match_state, pos);
+                pc = st->match_state;
+            }
+        }
+        else if(pc == PGEN_STATE_MATCH) {
+            // the rule is finished and its choices are dropped
+            pgen_frame_t* f = &parser->frames[--num_frames];
+            parser->active[f->rule] = f->saved_active;
+            num_choices = f->choice_base;
+
+            if(num_frames == 0) {
+                parser->farthest = farthest;
+                return pos;
+            }
+
+            FINISH_FRAME(&parser->memo, parser->frames, f, num_frames, pos);
+
+            const pgen_state_t* caller = &states[f->state];
+            if(caller->no_match_state != PGEN_STATE_NO_MATCH)
+                PUSH_CHOICE(caller->no_match_state, f->pos);
+            pc = caller->match_state;
+        }
+        else {
+            // back up to the last choice in this rule, or fail the rule
+            pgen_frame_t* f = &parser->frames[num_frames - 1];
+
+            if(num_choices > f->choice_base) {
+                num_choices--;
+                pc = parser->choices[num_choices].state;
+                pos = parser->choices[num_choices].pos;
+                continue;
+            }
+
+            num_frames--;
+            parser->active[f->rule] = f->saved_active;
+            pos = f->pos;
+
+            if(num_frames == 0) {
+                parser->farthest = farthest;
+                return -1;
+            }
+
+            FINISH_FRAME(&parser->memo, parser->frames, f, num_frames, PGEN_MEMO_FAIL);
+            pc = states[f->state].no_match_state;
+        }
+    }
+
+out_of_memory:
+    parser->farthest = farthest;
+    return -1;
+}
+
+uint32_t pgen_error_pos(pgen_parser_t* parser) {
+
+    return parser->farthest;
+}
+
+static int check_comb_header(const pgen_comb_header_t* comb, size_t size) {
+
+    if(size < sizeof(pgen_comb_header_t))
+        return 0;
+
+    if(comb->magic != PGEN_COMB_MAGIC || comb->version != PGEN_COMB_VERSION || comb->size > size)
+        return 0;
+
+    if(comb->num_symbols != 1 + comb->num_terminals + comb->num_rules + comb->num_actions
+       || comb->num_entries < comb->num_terminals + 1)
+        return 0;
+
+    uint64_t symbols = (uint64_t)comb->symbol_table + (uint64_t)comb->num_symbols * sizeof(pgen_symbol_t);
+    uint64_t states = (uint64_t)comb->state_table + (uint64_t)comb->num_states * sizeof(pgen_comb_state_t);
+    uint64_t entries = (uint64_t)comb->entry_table + (uint64_t)comb->num_entries * sizeof(pgen_comb_entry_t);
+    uint64_t calls = (uint64_t)comb->call_table + (uint64_t)comb->num_calls * sizeof(pgen_comb_call_t);
+    uint64_t first = (uint64_t)comb->first_table + (uint64_t)comb->num_first * comb->first_words * sizeof(uint32_t);
+    uint64_t strings = (uint64_t)comb->string_table + comb->string_size;
+
+    return symbols <= comb->state_table && states <= comb->entry_table && entries <= comb->call_table
+            && calls <= comb->first_table && first <= comb->string_table && strings <= comb->size
+            && comb->first_words >= (comb->num_terminals + 32) / 32 && (comb->symbol_table & 3) == 0
+            && (comb->state_table & 3) == 0 && (comb->entry_table & 3) == 0 && (comb->call_table & 3) == 0
+            && (comb->first_table & 3) == 0;
+}
+
+/*
+ * Map a file of compressed tables. Returns NULL if the file can not be
+ * mapped or if it is not of this version.
+ */
+const pgen_comb_header_t* pgen_open_comb(const char* fname) {
+
+    size_t size;
+    const pgen_comb_header_t* comb = map_file(fname, &size);
+    if(comb == NULL)
+        return NULL;
+
+    // pgen_close_comb() unmaps the size in the header
+    if(!check_comb_header(comb, size) || comb->size != size) {
+        munmap((void*)comb, size);
+        return NULL;
+    }
+
+    return comb;
+}
+
+void pgen_close_comb(const pgen_comb_header_t* comb) {
+
+    if(comb != NULL)
+        munmap((void*)comb, comb->size);
+}
+
+int pgen_check_comb(const pgen_comb_header_t* comb, size_t size) {
+
+    if(!check_comb_header(comb, size))
+        return 0;
+
+    const pgen_symbol_t* symbols = pgen_comb_symbols(comb);
+    const pgen_comb_state_t* states = pgen_comb_states(comb);
+    const pgen_comb_entry_t* entries = pgen_comb_entries(comb);
+    const pgen_comb_call_t* calls = pgen_comb_calls(comb);
+
+    for(uint32_t i = 0; i < comb->num_symbols; i++) {
+        if(symbols[i].name >= comb->string_size || symbols[i].text >= comb->string_size)
+            return 0;
+        if(symbols[i].type == PGEN_SYM_NON_TERMINAL && symbols[i].data >= comb->num_states
+           && symbols[i].data != PGEN_COMB_NONE)
+            return 0;
+    }
+
+    for(uint32_t i = 0; i < comb->num_states; i++) {
+        const pgen_comb_state_t* st = &states[i];
+        if((uint64_t)st->base + comb->num_terminals >= comb->num_entries
+           || (uint64_t)st->calls + st->num_calls > comb->num_calls)
+            return 0;
+        if(st->fallback != PGEN_COMB_NONE
+           && (st->fallback >= comb->num_states || states[st->fallback].fallback != PGEN_COMB_NONE))
+            return 0;
+    }
+
+    for(uint32_t i = 0; i < comb->num_entries; i++)
+        if(entries[i].check != PGEN_COMB_NONE
+           && (entries[i].check >= comb->num_states || entries[i].next >= comb->num_states))
+            return 0;
+
+    for(uint32_t i = 0; i < comb->num_calls; i++)
+        if(calls[i].symbol <= comb->num_terminals || calls[i].symbol >= comb->num_symbols
+           || calls[i].next >= comb->num_states || calls[i].first > comb->num_first)
+            return 0;
+
+    return comb->start_rule > comb->num_terminals && comb->start_rule <= comb->num_terminals + comb->num_rules;
+}
+
+pgen_comb_parser_t* pgen_create_comb_parser(const pgen_comb_header_t* comb, uint32_t depth) {
+
+    pgen_comb_parser_t* parser = calloc(1, sizeof(pgen_comb_parser_t));
+    if(parser == NULL)
+        return NULL;
+
+    if(depth < 16)
+        depth = 16;
+
+    parser->comb = comb;
+    parser->cap_frames = depth;
+    parser->frames = malloc(depth * sizeof(pgen_comb_frame_t));
+    parser->cap_choices = depth * 4;
+    parser->choices = malloc(parser->cap_choices * sizeof(pgen_comb_choice_t));
+    parser->active = calloc(comb->num_rules + 1, sizeof(uint32_t));
+
+    if(parser->frames == NULL || parser->choices == NULL || parser->active == NULL) {
+        pgen_destroy_comb_parser(parser);
+        return NULL;
+    }
+
+    return parser;
+}
+
+void pgen_destroy_comb_parser(pgen_comb_parser_t* parser) {
+
+    if(parser != NULL) {
+        free(parser->frames);
+        free(parser->choices);
+        free(parser->active);
+        memo_free(&parser->memo);
+        free(parser);
+    }
+}
+
+int pgen_set_comb_memo(pgen_comb_parser_t* parser, uint32_t size) {
+
+    return memo_resize(&parser->memo, size);
+}
+
+void pgen_set_comb_action(pgen_comb_parser_t* parser, pgen_action_t action, void* data) {
+
+    parser->action = action;
+    parser->data = data;
+}
+
+#define PUSH_COMB_CHOICE(s, k, p)                                                                \
+    do {                                                                                         \
+        if(num_choices >= parser->cap_choices                                                    \
+           && !grow((void**)&parser->choices, &parser->cap_choices, sizeof(pgen_comb_choice_t))) \
+            goto out_of_memory;                                                                  \
+        parser->choices[num_choices].state = (s);                                                \
+        parser->choices[num_choices].step = (k);                                                 \
+        parser->choices[num_choices].pos = (p);                                                  \
+        num_choices++;                                                                           \
+    } while(0)
+
+// there is something left to try in a state after the step
+#define MORE_STEPS(st, k) ((st)->accept || (k) + 1 <= 2 * (st)->num_calls)
+
+/*
+ * Parse the tokens with the start rule, as pgen_parse() does with the
+ * heap. A state tries its steps in order. The terminal steps are looked up
+ * in the compressed table with the current token, and only the one that
+ * matches it, if any, is tried.
+ */
+long pgen_comb_parse(pgen_comb_parser_t* parser, const uint32_t* tokens, uint32_t num_tokens) {
+
+    const pgen_comb_header_t* comb = parser->comb;
+    const pgen_comb_state_t* states = pgen_comb_states(comb);
+    const pgen_comb_call_t* calls = pgen_comb_calls(comb);
+    const pgen_symbol_t* symbols = pgen_comb_symbols(comb);
+    const uint32_t first_rule = comb->num_terminals + 1;
+    const uint32_t first_action = first_rule + comb->num_rules;
+
+    uint32_t num_frames = 0;
+    uint32_t num_choices = 0;
+    uint32_t pos = 0;
+    uint32_t farthest = 0;
+    uint32_t state = symbols[comb->start_rule].data;
+    uint32_t step = 0;
+
+    memset(parser->active, 0, comb->num_rules * sizeof(uint32_t));
+    memo_start(&parser->memo);
+
+    parser->frames[num_frames++]
+            = (pgen_comb_frame_t){ PGEN_COMB_NONE, 0, 0, comb->start_rule - first_rule, 0, 0, NO_DEPENDS };
+    parser->active[comb->start_rule - first_rule] = 1;
+
+    if(state == PGEN_COMB_NONE)
+        goto backtrack;
+
+    for(;;) {
+        const pgen_comb_state_t* st = &states[state];
+        uint32_t last = 2 * st->num_calls;
+
+        if((step & 1) == 0 && step <= last) {
+            if(pos < num_tokens) {
+                const pgen_comb_entry_t* e = pgen_comb_lookup(comb, state, tokens[pos]);
+                if(e != NULL && e->rank == step / 2) {
+                    if(MORE_STEPS(st, step))
+                        PUSH_COMB_CHOICE(state, step + 1, pos);
+                    if(++pos > farthest)
+                        farthest = pos;
+                    state = e->next;
+                    step = 0;
+                    continue;
+                }
+            }
+            step++;
+        }
+
+        if(step < last) {
+            const pgen_comb_call_t* call = &calls[st->calls + step / 2];
+
+            if(call->first != 0
+               && (pos >= num_tokens || !pgen_comb_first_test(comb, call->first - 1, tokens[pos]))) {
+                step++; // the token can not start this alternative
+                continue;
+            }
+
+            if(call->symbol >= first_action) {
+                if(parser->action != NULL)
+                    parser->action(call->symbol - first_action, pos, parser->data);
+                if(MORE_STEPS(st, step))
+                    PUSH_COMB_CHOICE(state, step + 1, pos);
+                state = call->next;
+                step = 0;
+                continue;
+            }
+
+            uint32_t rule = call->symbol - first_rule;
+            uint32_t entry = symbols[call->symbol].data;
+            if(parser->active[rule] == pos + 1) {
+                GUARD_DEPENDS(parser->frames, num_frames, rule, pos);
+                step++; // left recursion
+                continue;
+            }
+
+            if(entry == PGEN_COMB_NONE) {
+                step++; // a rule that never matches
+                continue;
+            }
+
+            const pgen_memo_entry_t* m = memo_find(&parser->memo, rule, pos);
+            if(m != NULL) {
+                if(m->end != PGEN_MEMO_FAIL) {
+                    if(MORE_STEPS(st, step))
+                        PUSH_COMB_CHOICE(state, step + 1, pos);
+                    pos = m->end;
+                    state = call->next;
+                    step = 0;
+                }
+                else
+                    step++;
+                continue;
+            }
+
+            if(num_frames >= parser->cap_frames
+               && !grow((void**)&parser->frames, &parser->cap_frames, sizeof(pgen_comb_frame_t)))
+                goto out_of_memory;
+
+            parser->frames[num_frames++]
+                    = (pgen_comb_frame_t){ state, step, pos, rule, num_choices, parser->active[rule], NO_DEPENDS };
+            parser->active[rule] = pos + 1;
+            state = entry;
+            step = 0;
+            continue;
+        }
+
+        if(st->accept) {
+            // the rule is finished and its choices are dropped
+            pgen_comb_frame_t* f = &parser->frames[--num_frames];
+            parser->active[f->rule] = f->saved_active;
+            num_choices = f->choice_base;
+
+            if(num_frames == 0) {
+                parser->farthest = farthest;
+                return pos;
+            }
+
+            FINISH_FRAME(&parser->memo, parser->frames, f, num_frames, pos);
+
+            const pgen_comb_state_t* caller = &states[f->state];
+            if(MORE_STEPS(caller, f->step))
+                PUSH_COMB_CHOICE(f->state, f->step + 1, f->pos);
+            state = calls[caller->calls + f->step / 2].next;
+            step = 0;
+            continue;
+        }
+
+    backtrack:
+        // back up to the last choice in this rule, or fail the rule
+        {
+            pgen_comb_frame_t* f = &parser->frames[num_frames - 1];
+
+            if(num_choices > f->choice_base) {
+                num_choices--;
+                state = parser->choices[num_choices].state;
+                step = parser->choices[num_choices].step;
+                pos = parser->choices[num_choices].pos;
+                continue;
+            }
+
+            num_frames--;
+            parser->active[f->rule] = f->saved_active;
+            pos = f->pos;
+
+            if(num_frames == 0) {
+                parser->farthest = farthest;
+                return -1;
+            }
+
+            FINISH_FRAME(&parser->memo, parser->frames, f, num_frames, PGEN_MEMO_FAIL);
+            state = f->state;
+            step = f->step + 1;
+        }
+    }
+
+out_of_memory:
+    parser->farthest = farthest;
+    return -1;
+}
+
+uint32_t pgen_comb_error_pos(pgen_comb_parser_t* parser) {
+
+    return parser->farthest;
+}
@@ -0,0 +1,126 @@
+/*
+ * Public interface of the pgen runtime. The runtime walks a state heap,
+ * as laid out in pgen_heap.h, over an array of terminal numbers.
+ *
+ * All of the stacks belong to the parser object. They are allocated when
+ * the parser is created and reused by every parse. They only grow if a
+ * parse goes deeper than any before it, so the parse loop does not
+ * allocate memory for each token.
+ */
+#ifndef _PGENRT_H_
+#define _PGENRT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "pgen_heap.h"
+#include "pgen_comb.h"
+
+// called for every code block that the parse passes through
+typedef void (*pgen_action_t)(uint32_t action, uint32_t pos, void* data);
+
+typedef struct {
+    uint32_t state; // calling state, its match_state is where to go next
+    uint32_t pos;   // input position where the rule started
+    uint32_t rule;
+    uint32_t choice_base; // choices below this belong to the caller
+    uint32_t saved_active;
+    uint32_t depends; // lowest frame that the result depends on, see pgenrt.c
+} pgen_frame_t;
+
+typedef struct {
+    uint32_t state; // alternative to try
+    uint32_t pos;   // input position to try it at
+} pgen_choice_t;
+
+#define PGEN_MEMO_FAIL 0xffffffffu
+
+typedef struct {
+    uint32_t generation; // parse that made the entry
+    uint32_t rule;
+    uint32_t pos;
+    uint32_t end; // input position after the rule, or PGEN_MEMO_FAIL
+} pgen_memo_entry_t;
+
+/*
+ * Results of rules by input position. The table is a fixed size cache, so
+ * an entry can be replaced by a later one that hashes to the same slot.
+ */
+typedef struct {
+    pgen_memo_entry_t* entries; // NULL when there is no memo
+    uint32_t mask;
+    uint32_t generation;
+} pgen_memo_t;
+
+typedef struct {
+    const pgen_heap_header_t* heap;
+    const pgen_state_t* states;
+    const pgen_symbol_t* symbols;
+    pgen_frame_t* frames;
+    uint32_t cap_frames;
+    pgen_choice_t* choices;
+    uint32_t cap_choices;
+    uint32_t* active; // position plus one of the innermost call of each rule
+    uint32_t farthest; // farthest input position that was reached
+    pgen_memo_t memo;
+    pgen_action_t action;
+    void* data;
+} pgen_parser_t;
+
+const pgen_heap_header_t* pgen_open_heap(const char* fname);
+void pgen_close_heap(const pgen_heap_header_t* heap);
+int pgen_check_heap(const pgen_heap_header_t* heap, size_t size);
+
+pgen_parser_t* pgen_create_parser(const pgen_heap_header_t* heap, uint32_t depth);
+void pgen_destroy_parser(pgen_parser_t* parser);
+void pgen_set_action(pgen_parser_t* parser, pgen_action_t action, void* data);
+int pgen_set_memo(pgen_parser_t* parser, uint32_t size);
+long pgen_parse(pgen_parser_t* parser, const uint32_t* tokens, uint32_t num_tokens);
+uint32_t pgen_error_pos(pgen_parser_t* parser);
+
+/*
+ * The same parser over the compressed tables. The position of the parser
+ * inside of a state is a step. An even step 2 * i is the terminal that
+ * comes before call i, and an odd step 2 * i + 1 is call i.
+ */
+typedef struct {
+    uint32_t state; // calling state
+    uint32_t step;  // step of the call in the calling state
+    uint32_t pos;
+    uint32_t rule;
+    uint32_t choice_base;
+    uint32_t saved_active;
+    uint32_t depends;
+} pgen_comb_frame_t;
+
+typedef struct {
+    uint32_t state;
+    uint32_t step;
+    uint32_t pos;
+} pgen_comb_choice_t;
+
+typedef struct {
+    const pgen_comb_header_t* comb;
+    pgen_comb_frame_t* frames;
+    uint32_t cap_frames;
+    pgen_comb_choice_t* choices;
+    uint32_t cap_choices;
+    uint32_t* active;
+    uint32_t farthest;
+    pgen_memo_t memo;
+    pgen_action_t action;
+    void* data;
+} pgen_comb_parser_t;
+
+const pgen_comb_header_t* pgen_open_comb(const char* fname);
+void pgen_close_comb(const pgen_comb_header_t* comb);
+int pgen_check_comb(const pgen_comb_header_t* comb, size_t size);
+
+pgen_comb_parser_t* pgen_create_comb_parser(const pgen_comb_header_t* comb, uint32_t depth);
+void pgen_destroy_comb_parser(pgen_comb_parser_t* parser);
+void pgen_set_comb_action(pgen_comb_parser_t* parser, pgen_action_t action, void* data);
+int pgen_set_comb_memo(pgen_comb_parser_t* parser, uint32_t size);
+long pgen_comb_parse(pgen_comb_parser_t* parser, const uint32_t* tokens, uint32_t num_tokens);
+uint32_t pgen_comb_error_pos(pgen_comb_parser_t* parser);
+
+#endif /* _PGENRT_H_ */
@@ -0,0 +1,30 @@
+# Check that the compressed tables of a grammar take at most a tenth of
+# the space of a dense transition table, by the sizes that pgen -d comb
+# prints.
+#
+#     cmake -DPGEN=pgen -DGRAMMAR=toy1.g -DOUTPUT=toy1.comb -P comb_size.cmake
+
+execute_process(
+    COMMAND ${PGEN} -f comb -d comb -o ${OUTPUT} ${GRAMMAR}
+    RESULT_VARIABLE result
+    OUTPUT_QUIET
+    ERROR_VARIABLE dump
+)
+
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "pgen failed on ${GRAMMAR}:\n${dump}")
+endif()
+
+string(REGEX MATCH "comb: [^\n]*, ([0-9]+) bytes of tables \\(dense would be ([0-9]+)\\)" stats "${dump}")
+if(NOT stats)
+    message(FATAL_ERROR "pgen did not print the comb sizes of ${GRAMMAR}")
+endif()
+
+set(comb_bytes ${CMAKE_MATCH_1})
+set(dense_bytes ${CMAKE_MATCH_2})
+math(EXPR limit "${dense_bytes} / 10")
+
+message("${stats}")
+if(comb_bytes GREATER limit)
+    message(FATAL_ERROR "${comb_bytes} bytes of tables is more than a tenth of ${dense_bytes}")
+endif()
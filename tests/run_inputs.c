@@ -0,0 +1,317 @@
+/*
+ * Parse the inputs in a file with the tables that pgen made for a grammar
+ * and check every result against the one that the file expects.
+ *
+ *     run_inputs inputs-file table-file...
+ *
+ * A table file is a .heap or a .comb file of the same grammar. Every table
+ * must give the same length and error position for an input, as well as
+ * the expected result.
+ *
+ * When it is built with TEST_CODE, the parser that pgen -f code wrote to
+ * test_code.c is run on every input as well. Its terminals have the same
+ * numbers as in the heap, so the first table must be the heap.
+ *
+ * Each line of the inputs file is one of
+ *
+ *     accept token...
+ *     reject pos token...
+ *
+ * where a token is a terminal as it is written in the grammar, such as
+ * NUMBER or '+'. An input is accepted when the start rule matches all of
+ * it, and pos is the error position that a rejected input must give.
+ * Blank lines and lines that start with # are skipped.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pgenrt.h"
+
+#ifdef TEST_CODE
+#include "test_code.h"
+#endif
+
+typedef struct {
+    const char* fname;
+    const pgen_heap_header_t* heap; // NULL for a comb
+    pgen_parser_t* parser;
+    const pgen_comb_header_t* comb;
+    pgen_comb_parser_t* comb_parser;
+#ifdef TEST_CODE
+    test_code_parser_t* code_parser; // the heap is that of the first table
+#endif
+} table_t;
+
+typedef struct {
+    int accept;
+    uint32_t pos;
+    char** names;
+    uint32_t num_tokens;
+    uint32_t cap_tokens;
+} input_t;
+
+static int open_table(table_t* tab, const char* fname) {
+
+    const char* dot = strrchr(fname, '.');
+
+    memset(tab, 0, sizeof(table_t));
+    tab->fname = fname;
+    if(dot != NULL && strcmp(dot, ".comb") == 0) {
+        if(NULL != (tab->comb = pgen_open_comb(fname)))
+            tab->comb_parser = pgen_create_comb_parser(tab->comb, 0);
+    }
+    else if(NULL != (tab->heap = pgen_open_heap(fname)))
+        tab->parser = pgen_create_parser(tab->heap, 0);
+
+    if(tab->parser == NULL && tab->comb_parser == NULL) {
+        fprintf(stderr, "cannot open the tables in \"%s\"\n", fname);
+        return 0;
+    }
+
+    return 1;
+}
+
+#ifdef TEST_CODE
+static int open_code(table_t* tab, table_t* first) {
+
+    memset(tab, 0, sizeof(table_t));
+    tab->fname = "test_code.c";
+    tab->heap = first->heap;
+    if(tab->heap == NULL) {
+        fprintf(stderr, "the first table must be a heap\n");
+        return 0;
+    }
+
+    tab->code_parser = test_code_create_parser(0);
+    return tab->code_parser != NULL;
+}
+#endif
+
+static void close_table(table_t* tab) {
+
+#ifdef TEST_CODE
+    if(tab->code_parser != NULL) {
+        test_code_destroy_parser(tab->code_parser);
+        return;
+    }
+#endif
+
+    if(tab->heap != NULL) {
+        pgen_destroy_parser(tab->parser);
+        pgen_close_heap(tab->heap);
+    }
+    else {
+        pgen_destroy_comb_parser(tab->comb_parser);
+        pgen_close_comb(tab->comb);
+    }
+}
+
+// the number of the terminal with the text, or zero
+static uint32_t find_terminal(table_t* tab, const char* text) {
+
+    const pgen_symbol_t* symbols = (tab->heap != NULL) ? pgen_heap_symbols(tab->heap) : pgen_comb_symbols(tab->comb);
+    uint32_t num_terminals = (tab->heap != NULL) ? tab->heap->num_terminals : tab->comb->num_terminals;
+
+    for(uint32_t s = 1; s <= num_terminals; s++) {
+        const char* str = (tab->heap != NULL) ? pgen_heap_string(tab->heap, symbols[s].text)
+                                              : pgen_comb_string(tab->comb, symbols[s].text);
+        if(strcmp(str, text) == 0)
+            return s;
+    }
+
+    return 0;
+}
+
+// returns the length that the start rule matched, or -1
+static long parse_table(table_t* tab, const uint32_t* tokens, uint32_t num_tokens, uint32_t* pos) {
+
+    long len;
+
+#ifdef TEST_CODE
+    if(tab->code_parser != NULL) {
+        len = test_code_parse(tab->code_parser, tokens, num_tokens, NULL);
+        *pos = test_code_error_pos(tab->code_parser);
+        return len;
+    }
+#endif
+
+    if(tab->heap != NULL) {
+        len = pgen_parse(tab->parser, tokens, num_tokens);
+        *pos = pgen_error_pos(tab->parser);
+    }
+    else {
+        len = pgen_comb_parse(tab->comb_parser, tokens, num_tokens);
+        *pos = pgen_comb_error_pos(tab->comb_parser);
+    }
+
+    return len;
+}
+
+// returns non-zero if the line is an input, and -1 if it is not valid
+static int read_input(input_t* in, char* line) {
+
+    char* word = strtok(line, " \t\r\n");
+    if(word == NULL || word[0] == '#')
+        return 0;
+
+    in->num_tokens = 0;
+    if(strcmp(word, "accept") == 0)
+        in->accept = 1;
+    else if(strcmp(word, "reject") == 0) {
+        in->accept = 0;
+        char* pos = strtok(NULL, " \t\r\n");
+        char* end;
+        if(pos == NULL || (in->pos = strtoul(pos, &end, 10), *end != '\0'))
+            return -1;
+    }
+    else
+        return -1;
+
+    while(NULL != (word = strtok(NULL, " \t\r\n"))) {
+        if(in->num_tokens >= in->cap_tokens) {
+            in->cap_tokens = (in->cap_tokens > 0) ? in->cap_tokens * 2 : 64;
+            in->names = realloc(in->names, in->cap_tokens * sizeof(char*));
+            if(in->names == NULL) {
+                perror("run_inputs");
+                exit(1);
+            }
+        }
+        in->names[in->num_tokens++] = word;
+    }
+
+    return 1;
+}
+
+/*
+ * Returns non-zero if the table gives the result that the input expects.
+ * The length that the start rule matched and the error position are left
+ * in *plen and *ppos.
+ */
+static int run_input(table_t* tab, input_t* in, uint32_t* tokens, const char* fname, int line_no, long* plen,
+                     uint32_t* ppos) {
+
+    *plen = -1;
+    *ppos = 0;
+    for(uint32_t i = 0; i < in->num_tokens; i++)
+        if(0 == (tokens[i] = find_terminal(tab, in->names[i]))) {
+            fprintf(stderr, "%s:%d: %s has no terminal %s\n", fname, line_no, tab->fname, in->names[i]);
+            return 0;
+        }
+
+    uint32_t pos;
+    long len = parse_table(tab, tokens, in->num_tokens, &pos);
+
+    *plen = len;
+    *ppos = pos;
+
+    if(in->accept && len != (long)in->num_tokens) {
+        fprintf(stderr, "%s:%d: %s: expected the input to be accepted, it was not (error at %u)\n", fname, line_no,
+                tab->fname, pos);
+        return 0;
+    }
+
+    if(!in->accept && (len == (long)in->num_tokens || pos != in->pos)) {
+        if(len == (long)in->num_tokens)
+            fprintf(stderr, "%s:%d: %s: expected the input to be rejected, it was accepted\n", fname, line_no,
+                    tab->fname);
+        else
+            fprintf(stderr, "%s:%d: %s: expected the error at %u, it was at %u\n", fname, line_no, tab->fname,
+                    in->pos, pos);
+        return 0;
+    }
+
+    return 1;
+}
+
+int main(int argc, char** argv) {
+
+    if(argc < 3) {
+        fprintf(stderr, "use: run_inputs inputs-file table-file...\n");
+        return 1;
+    }
+
+    FILE* fp = fopen(argv[1], "r");
+    if(fp == NULL) {
+        perror(argv[1]);
+        return 1;
+    }
+
+    int num_tables = argc - 2;
+    table_t* tabs = calloc(num_tables + 1, sizeof(table_t));
+    if(tabs == NULL) {
+        perror("run_inputs");
+        return 1;
+    }
+
+    for(int t = 0; t < num_tables; t++)
+        if(!open_table(&tabs[t], argv[t + 2]))
+            return 1;
+
+#ifdef TEST_CODE
+    if(!open_code(&tabs[num_tables], &tabs[0]))
+        return 1;
+    num_tables++;
+#endif
+
+    input_t in = { 0 };
+    uint32_t* tokens = NULL;
+    char line[4096];
+    int line_no = 0;
+    int num_inputs = 0;
+    int failed = 0;
+
+    while(fgets(line, sizeof(line), fp) != NULL) {
+        line_no++;
+
+        int ok = read_input(&in, line);
+        if(ok < 0) {
+            fprintf(stderr, "%s:%d: expected \"accept\" or \"reject pos\"\n", argv[1], line_no);
+            failed++;
+            continue;
+        }
+        else if(ok == 0)
+            continue;
+
+        tokens = realloc(tokens, (in.num_tokens + 1) * sizeof(uint32_t));
+        if(tokens == NULL) {
+            perror("run_inputs");
+            return 1;
+        }
+
+        num_inputs++;
+        long first_len = 0;
+        uint32_t first_pos = 0;
+        int ok_all = 1;
+        for(int t = 0; t < num_tables; t++) {
+            long len;
+            uint32_t pos;
+            if(!run_input(&tabs[t], &in, tokens, argv[1], line_no, &len, &pos))
+                ok_all = 0;
+
+            if(t == 0) {
+                first_len = len;
+                first_pos = pos;
+            }
+            else if(len != first_len || pos != first_pos) {
+                fprintf(stderr, "%s:%d: %s matched %ld with the error at %u, %s matched %ld with the error at %u\n",
+                        argv[1], line_no, tabs[0].fname, first_len, first_pos, tabs[t].fname, len, pos);
+                ok_all = 0;
+            }
+        }
+
+        if(!ok_all)
+            failed++;
+    }
+
+    printf("%s: %d inputs, %d tables, %d failed\n", argv[1], num_inputs, num_tables, failed);
+
+    for(int t = 0; t < num_tables; t++)
+        close_table(&tabs[t]);
+    free(tabs);
+    free(tokens);
+    free(in.names);
+    fclose(fp);
+
+    return (failed == 0 && num_inputs > 0) ? 0 : 1;
+}
@@ -0,0 +1,26 @@
+# Check that pgen writes the same heap for a grammar whatever the number
+# of threads that build its NFA and DFA.
+#
+#     cmake -DPGEN=pgen -DGRAMMAR=toy1.g -DOUTPUT=toy1 -DTHREADS=8 -P threads.cmake
+
+foreach(threads 1 ${THREADS})
+    execute_process(
+        COMMAND ${PGEN} -t ${threads} -o ${OUTPUT}-t${threads}.heap ${GRAMMAR}
+        RESULT_VARIABLE result
+        OUTPUT_QUIET
+        ERROR_VARIABLE dump
+    )
+
+    if(NOT result EQUAL 0)
+        message(FATAL_ERROR "pgen -t ${threads} failed on ${GRAMMAR}:\n${dump}")
+    endif()
+endforeach()
+
+execute_process(
+    COMMAND ${CMAKE_COMMAND} -E compare_files ${OUTPUT}-t1.heap ${OUTPUT}-t${THREADS}.heap
+    RESULT_VARIABLE result
+)
+
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "the heaps of ${GRAMMAR} with 1 and ${THREADS} threads are not the same")
+endif()